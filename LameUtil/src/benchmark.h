@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <chrono>
+#include <string>
 
 /*
 RAII based timer class.
@@ -23,7 +24,7 @@ Usage:
 To change the precision of the timer, redefine the global variable g_TimerPrecision
 */
 
-#if BENCHMARKING 1
+#if BENCHMARKING
 #define BENCHMARK_SCOPE(scopeName) lameutil::BenchTimer timer##__LINE__(scopeName)
 #define BENCHMARK_FUNCTION() BENCHMARK_SCOPE(__FUNCSIG__)
 #else 
@@ -0,0 +1,567 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include "easyRandom.h"
+#include "cpuDispatch.h"
+
+/*
+Counter based random number generation (Philox4x32-10, Salmon et al. "Parallel random numbers: as easy as 1, 2, 3").
+
+The value at index i is a pure function of (seed, i), costs O(1) to compute and needs no shared state,
+so any partition or ordering of a parallel loop produces identical results. Results are identical
+on every platform and for the scalar and the batched code paths (SSE4.2, AVX2 or AVX-512 chosen at runtime).
+
+
+Philox4x32::Block Philox4x32::generate(Block counter, Key key)
+The raw 128 bit bijection.
+
+CounterRandom(uint64_t seed)
+Constructor which sets the key of the generator.
+
+uint32_t getU32(uint64_t i) / uint64_t getU64(uint64_t i)
+Returns the i-th 32 / 64 bit value of the sequence.
+
+double getDouble(uint64_t i), double getDouble(uint64_t i, double min, double max)
+Returns the i-th double in the range [0, 1> / [min, max>. Uses getU64(i).
+
+float getFloat(uint64_t i)
+Returns the i-th float in the range [0, 1>. Uses getU32(i).
+
+int getInt(uint64_t i, int min, int max)
+Returns the i-th integer in the range [min, max>. Uses getU64(i).
+
+void fillU32(uint64_t first, uint32_t* out, size_t count)
+void fillU64(uint64_t first, uint64_t* out, size_t count)
+void fillDouble(uint64_t first, double* out, size_t count)
+void fillFloat(uint64_t first, float* out, size_t count)
+Batched variants, out[j] is equal to the scalar value at index first + j.
+
+PhiloxEngine engine(uint64_t stream)
+Returns a sequential standard conforming engine over an independent counter space, usable with
+BasicEasyRandom<PhiloxEngine> and the standard distributions.
+
+uint64_t counterRandom(uint64_t seed, uint64_t i)
+Shorthand for CounterRandom(seed).getU64(i).
+
+
+Example:
+
+lameutil::CounterRandom rg(42);
+std::vector<double> out(n);
+#pragma omp parallel for
+for(int64_t i = 0; i < n; i++)
+{
+	out[i] = rg.getDouble(i);
+}
+//same as
+rg.fillDouble(0, out.data(), n);
+
+*/
+
+namespace lameutil
+{
+	struct Philox4x32
+	{
+		struct Block { uint32_t v[4]; };
+		struct Key { uint32_t v[2]; };
+
+		static constexpr uint32_t M0 = 0xD2511F53u;
+		static constexpr uint32_t M1 = 0xCD9E8D57u;
+		static constexpr uint32_t W0 = 0x9E3779B9u;
+		static constexpr uint32_t W1 = 0xBB67AE85u;
+		static constexpr int ROUNDS = 10;
+
+		static inline Block generate(Block ctr, Key key)
+		{
+			for(int r = 0; r < ROUNDS; r++)
+			{
+				if(r)
+				{
+					key.v[0] += W0;
+					key.v[1] += W1;
+				}
+				const uint64_t p0 = (uint64_t)M0 * ctr.v[0];
+				const uint64_t p1 = (uint64_t)M1 * ctr.v[2];
+				Block next;
+				next.v[0] = (uint32_t)(p1 >> 32) ^ ctr.v[1] ^ key.v[0];
+				next.v[1] = (uint32_t)p1;
+				next.v[2] = (uint32_t)(p0 >> 32) ^ ctr.v[3] ^ key.v[1];
+				next.v[3] = (uint32_t)p0;
+				ctr = next;
+			}
+			return ctr;
+		}
+
+		//generates the blocks with the 64 bit counters first + j for j in [0, count>, interleaved into out[4 * j + w].
+		//Dispatched at runtime to the widest variant the CPU supports (cpuDispatch.h)
+		static inline void generateBlocks(uint64_t first, size_t count, Key key, uint32_t* out);
+	};
+
+	namespace detail
+	{
+		//upper 64 bits of the 128 bit product a * b
+		inline uint64_t mulHi64(uint64_t a, uint64_t b)
+		{
+#if defined(__SIZEOF_INT128__)
+			return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+			const uint64_t aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32;
+			const uint64_t lo = aLo * bLo, mid1 = aHi * bLo, mid2 = aLo * bHi;
+			const uint64_t carry = ((lo >> 32) + (uint32_t)mid1 + (uint32_t)mid2) >> 32;
+			return aHi * bHi + (mid1 >> 32) + (mid2 >> 32) + carry;
+#endif
+		}
+
+		inline void philoxBlocksScalar(uint64_t first, size_t count, Philox4x32::Key key, uint32_t* out)
+		{
+			for(size_t j = 0; j < count; j++)
+			{
+				const uint64_t c = first + j;
+				Philox4x32::Block b = Philox4x32::generate(Philox4x32::Block{{(uint32_t)c, (uint32_t)(c >> 32), 0, 0}}, key);
+				out[4 * j + 0] = b.v[0];
+				out[4 * j + 1] = b.v[1];
+				out[4 * j + 2] = b.v[2];
+				out[4 * j + 3] = b.v[3];
+			}
+		}
+
+#if LAME_ISA_SSE42
+		LAME_TARGET_SSE42 inline void philoxMulhilo(__m128i a, __m128i m, __m128i& hi, __m128i& lo)
+		{
+			const __m128i even = _mm_mul_epu32(a, m);
+			const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+			const __m128i loMask = _mm_set_epi32(0, -1, 0, -1);
+			lo = _mm_or_si128(_mm_and_si128(even, loMask), _mm_slli_epi64(odd, 32));
+			hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(loMask, odd));
+		}
+
+		//4 blocks per step
+		LAME_TARGET_SSE42 inline void philoxBlocksSse42(uint64_t first, size_t count, Philox4x32::Key key0, uint32_t* out)
+		{
+			size_t j = 0;
+			for(; j + 4 <= count; j += 4, out += 16)
+			{
+				const uint64_t f = first + j;
+				__m128i c0 = _mm_set_epi32((int)(uint32_t)(f + 3), (int)(uint32_t)(f + 2), (int)(uint32_t)(f + 1), (int)(uint32_t)f);
+				__m128i c1 = _mm_set_epi32((int)(uint32_t)((f + 3) >> 32), (int)(uint32_t)((f + 2) >> 32), (int)(uint32_t)((f + 1) >> 32), (int)(uint32_t)(f >> 32));
+				__m128i c2 = _mm_setzero_si128();
+				__m128i c3 = _mm_setzero_si128();
+				const __m128i m0 = _mm_set1_epi32((int)Philox4x32::M0);
+				const __m128i m1 = _mm_set1_epi32((int)Philox4x32::M1);
+				Philox4x32::Key key = key0;
+				for(int r = 0; r < Philox4x32::ROUNDS; r++)
+				{
+					if(r)
+					{
+						key.v[0] += Philox4x32::W0;
+						key.v[1] += Philox4x32::W1;
+					}
+					__m128i hi0, lo0, hi1, lo1;
+					philoxMulhilo(c0, m0, hi0, lo0);
+					philoxMulhilo(c2, m1, hi1, lo1);
+					c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32((int)key.v[0]));
+					c1 = lo1;
+					c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32((int)key.v[1]));
+					c3 = lo0;
+				}
+				//transpose the 4 lanes x 4 words into 4 consecutive blocks
+				const __m128i t0 = _mm_unpacklo_epi32(c0, c1);
+				const __m128i t1 = _mm_unpacklo_epi32(c2, c3);
+				const __m128i t2 = _mm_unpackhi_epi32(c0, c1);
+				const __m128i t3 = _mm_unpackhi_epi32(c2, c3);
+				_mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi64(t0, t1));
+				_mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi64(t0, t1));
+				_mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi64(t2, t3));
+				_mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi64(t2, t3));
+			}
+			philoxBlocksScalar(first + j, count - j, key0, out);
+		}
+#endif
+
+#if LAME_ISA_AVX2
+		LAME_TARGET_AVX2 inline void philoxMulhilo(__m256i a, __m256i m, __m256i& hi, __m256i& lo)
+		{
+			const __m256i even = _mm256_mul_epu32(a, m);
+			const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+			const __m256i loMask = _mm256_set1_epi64x(0xffffffffLL);
+			lo = _mm256_or_si256(_mm256_and_si256(even, loMask), _mm256_slli_epi64(odd, 32));
+			hi = _mm256_or_si256(_mm256_srli_epi64(even, 32), _mm256_andnot_si256(loMask, odd));
+		}
+
+		//8 blocks per step
+		LAME_TARGET_AVX2 inline void philoxBlocksAvx2(uint64_t first, size_t count, Philox4x32::Key key0, uint32_t* out)
+		{
+			size_t j = 0;
+			for(; j + 8 <= count; j += 8, out += 32)
+			{
+				alignas(32) uint32_t lo[8], hi[8];
+				for(int l = 0; l < 8; l++)
+				{
+					lo[l] = (uint32_t)(first + j + l);
+					hi[l] = (uint32_t)((first + j + l) >> 32);
+				}
+				__m256i c0 = _mm256_load_si256((const __m256i*)lo);
+				__m256i c1 = _mm256_load_si256((const __m256i*)hi);
+				__m256i c2 = _mm256_setzero_si256();
+				__m256i c3 = _mm256_setzero_si256();
+				const __m256i m0 = _mm256_set1_epi32((int)Philox4x32::M0);
+				const __m256i m1 = _mm256_set1_epi32((int)Philox4x32::M1);
+				Philox4x32::Key key = key0;
+				for(int r = 0; r < Philox4x32::ROUNDS; r++)
+				{
+					if(r)
+					{
+						key.v[0] += Philox4x32::W0;
+						key.v[1] += Philox4x32::W1;
+					}
+					__m256i hi0, lo0, hi1, lo1;
+					philoxMulhilo(c0, m0, hi0, lo0);
+					philoxMulhilo(c2, m1, hi1, lo1);
+					c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)key.v[0]));
+					c1 = lo1;
+					c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)key.v[1]));
+					c3 = lo0;
+				}
+				alignas(32) uint32_t r0[8], r1[8], r2[8], r3[8];
+				_mm256_store_si256((__m256i*)r0, c0);
+				_mm256_store_si256((__m256i*)r1, c1);
+				_mm256_store_si256((__m256i*)r2, c2);
+				_mm256_store_si256((__m256i*)r3, c3);
+				for(int l = 0; l < 8; l++)
+				{
+					out[4 * l + 0] = r0[l];
+					out[4 * l + 1] = r1[l];
+					out[4 * l + 2] = r2[l];
+					out[4 * l + 3] = r3[l];
+				}
+			}
+			philoxBlocksScalar(first + j, count - j, key0, out);
+		}
+#endif
+
+#if LAME_ISA_AVX512
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+//false positive of GCC on the _mm512_undefined_epi32() inside _mm512_mul_epu32 when compiled for a target attribute
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+		LAME_TARGET_AVX512 inline void philoxMulhilo(__m512i a, __m512i m, __m512i& hi, __m512i& lo)
+		{
+			const __m512i even = _mm512_mul_epu32(a, m);
+			const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+			const __m512i loMask = _mm512_set1_epi64(0xffffffffLL);
+			lo = _mm512_or_si512(_mm512_and_si512(even, loMask), _mm512_slli_epi64(odd, 32));
+			hi = _mm512_or_si512(_mm512_srli_epi64(even, 32), _mm512_andnot_si512(loMask, odd));
+		}
+
+		//16 blocks per step, the words are interleaved into blocks with two rounds of 2 source permutes
+		LAME_TARGET_AVX512 inline void philoxBlocksAvx512(uint64_t first, size_t count, Philox4x32::Key key0, uint32_t* out)
+		{
+			const __m512i lane = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+			//(a0 b0 a1 b1 ...) of the lower and upper 8 lanes of a and b
+			const __m512i pairLo = _mm512_set_epi32(23, 7, 22, 6, 21, 5, 20, 4, 19, 3, 18, 2, 17, 1, 16, 0);
+			const __m512i pairHi = _mm512_set_epi32(31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25, 9, 24, 8);
+			//the same for 64 bit pairs
+			const __m512i quadLo = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);
+			const __m512i quadHi = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+			size_t j = 0;
+			for(; j + 16 <= count; j += 16, out += 64)
+			{
+				//64 bit counters f + l, split into low and high words with the carry of the low word
+				const uint64_t f = first + j;
+				const __m512i low = _mm512_add_epi32(_mm512_set1_epi32((int)(uint32_t)f), lane);
+				const __mmask16 carry = _mm512_cmplt_epu32_mask(low, _mm512_set1_epi32((int)(uint32_t)f));
+				__m512i c0 = low;
+				__m512i c1 = _mm512_mask_add_epi32(_mm512_set1_epi32((int)(uint32_t)(f >> 32)), carry, _mm512_set1_epi32((int)(uint32_t)(f >> 32)), _mm512_set1_epi32(1));
+				__m512i c2 = _mm512_setzero_si512();
+				__m512i c3 = _mm512_setzero_si512();
+				const __m512i m0 = _mm512_set1_epi32((int)Philox4x32::M0);
+				const __m512i m1 = _mm512_set1_epi32((int)Philox4x32::M1);
+				Philox4x32::Key key = key0;
+				for(int r = 0; r < Philox4x32::ROUNDS; r++)
+				{
+					if(r)
+					{
+						key.v[0] += Philox4x32::W0;
+						key.v[1] += Philox4x32::W1;
+					}
+					__m512i hi0, lo0, hi1, lo1;
+					philoxMulhilo(c0, m0, hi0, lo0);
+					philoxMulhilo(c2, m1, hi1, lo1);
+					c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32((int)key.v[0]));
+					c1 = lo1;
+					c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32((int)key.v[1]));
+					c3 = lo0;
+				}
+				const __m512i w01Lo = _mm512_permutex2var_epi32(c0, pairLo, c1);
+				const __m512i w01Hi = _mm512_permutex2var_epi32(c0, pairHi, c1);
+				const __m512i w23Lo = _mm512_permutex2var_epi32(c2, pairLo, c3);
+				const __m512i w23Hi = _mm512_permutex2var_epi32(c2, pairHi, c3);
+				_mm512_storeu_si512(out + 0, _mm512_permutex2var_epi64(w01Lo, quadLo, w23Lo));
+				_mm512_storeu_si512(out + 16, _mm512_permutex2var_epi64(w01Lo, quadHi, w23Lo));
+				_mm512_storeu_si512(out + 32, _mm512_permutex2var_epi64(w01Hi, quadLo, w23Hi));
+				_mm512_storeu_si512(out + 48, _mm512_permutex2var_epi64(w01Hi, quadHi, w23Hi));
+			}
+			philoxBlocksScalar(first + j, count - j, key0, out);
+		}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+	}
+
+	inline void Philox4x32::generateBlocks(uint64_t first, size_t count, Key key, uint32_t* out)
+	{
+		typedef void Kernel(uint64_t, size_t, Key, uint32_t*);
+		static const Dispatch<Kernel> kernel(detail::philoxBlocksScalar, LAME_IF_SSE42(detail::philoxBlocksSse42),
+			LAME_IF_AVX2(detail::philoxBlocksAvx2), LAME_IF_AVX512(detail::philoxBlocksAvx512));
+		kernel(first, count, key, out);
+	}
+
+	class PhiloxEngine
+	{
+	private:
+		Philox4x32::Key key;
+		Philox4x32::Block counter;
+		Philox4x32::Block buffer;
+		int index;
+
+		void refill()
+		{
+			buffer = Philox4x32::generate(counter, key);
+			if(++counter.v[0] == 0)
+			{
+				counter.v[1]++;
+			}
+			index = 0;
+		}
+
+	public:
+		typedef uint32_t result_type;
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		PhiloxEngine() : PhiloxEngine(0)
+		{
+		}
+		explicit PhiloxEngine(uint64_t seed, uint64_t stream = 0)
+		{
+			setState(seed, stream);
+		}
+		explicit PhiloxEngine(std::seed_seq& seq)
+		{
+			seed(seq);
+		}
+
+		void seed(uint64_t value)
+		{
+			setState(value, 0);
+		}
+		void seed(std::seed_seq& seq)
+		{
+			uint32_t words[4];
+			seq.generate(words, words + 4);
+			setState((uint64_t(words[1]) << 32) | words[0], (uint64_t(words[3]) << 32) | words[2]);
+		}
+
+		result_type operator()()
+		{
+			if(index == 4)
+			{
+				refill();
+			}
+			return buffer.v[index++];
+		}
+
+		void discard(unsigned long long n)
+		{
+			//skipping whole blocks only moves the counter
+			const unsigned long long available = 4 - index;
+			if(n < available)
+			{
+				index += (int)n;
+				return;
+			}
+			n -= available;
+			const uint64_t c = ((uint64_t(counter.v[1]) << 32) | counter.v[0]) + n / 4;
+			counter.v[0] = (uint32_t)c;
+			counter.v[1] = (uint32_t)(c >> 32);
+			refill();
+			index = (int)(n % 4);
+		}
+
+		friend bool operator==(const PhiloxEngine& lhs, const PhiloxEngine& rhs)
+		{
+			for(int i = 0; i < 4; i++)
+			{
+				if(lhs.counter.v[i] != rhs.counter.v[i])
+					return false;
+			}
+			return lhs.key.v[0] == rhs.key.v[0] && lhs.key.v[1] == rhs.key.v[1] && lhs.index == rhs.index;
+		}
+		friend bool operator!=(const PhiloxEngine& lhs, const PhiloxEngine& rhs)
+		{
+			return !(lhs == rhs);
+		}
+
+	private:
+		void setState(uint64_t value, uint64_t stream)
+		{
+			key.v[0] = (uint32_t)value;
+			key.v[1] = (uint32_t)(value >> 32);
+			counter.v[0] = 0;
+			counter.v[1] = 0;
+			counter.v[2] = (uint32_t)stream;
+			counter.v[3] = (uint32_t)(stream >> 32);
+			refill();
+		}
+	};
+
+	class CounterRandom
+	{
+	private:
+		Philox4x32::Key key;
+
+		static constexpr size_t CHUNK_BLOCKS = 64;
+
+		Philox4x32::Block block(uint64_t b) const
+		{
+			return Philox4x32::generate(Philox4x32::Block{{(uint32_t)b, (uint32_t)(b >> 32), 0, 0}}, key);
+		}
+
+		static inline double toDouble(uint64_t x)
+		{
+			return (x >> 11) * (1.0 / 9007199254740992.0);
+		}
+		static inline float toFloat(uint32_t x)
+		{
+			return (x >> 8) * (1.0f / 16777216.0f);
+		}
+
+	public:
+		explicit CounterRandom(uint64_t seed)
+		{
+			key.v[0] = (uint32_t)seed;
+			key.v[1] = (uint32_t)(seed >> 32);
+		}
+
+		uint32_t getU32(uint64_t i) const
+		{
+			return block(i / 4).v[i % 4];
+		}
+		uint64_t getU64(uint64_t i) const
+		{
+			const Philox4x32::Block b = block(i / 2);
+			const int w = (int)(i % 2) * 2;
+			return (uint64_t(b.v[w + 1]) << 32) | b.v[w];
+		}
+
+		double getDouble(uint64_t i) const
+		{
+			return toDouble(getU64(i));
+		}
+		double getDouble(uint64_t i, double min, double max) const
+		{
+			return min + (max - min) * getDouble(i);
+		}
+		float getFloat(uint64_t i) const
+		{
+			return toFloat(getU32(i));
+		}
+		int getInt(uint64_t i, int min, int max) const
+		{
+			//multiply-shift range reduction of all 64 bits, the bias is at most range / 2^64 < 2^-32 for any int range.
+			//A stateless draw has no second value for a rejection step
+			const uint64_t range = (uint64_t)((int64_t)max - min);
+			return (int)((int64_t)min + (int64_t)detail::mulHi64(getU64(i), range));
+		}
+
+		void fillU32(uint64_t first, uint32_t* out, size_t count) const
+		{
+			for(; count && (first % 4); count--)
+			{
+				*out++ = getU32(first++);
+			}
+			Philox4x32::generateBlocks(first / 4, count / 4, key, out);
+			out += (count / 4) * 4;
+			first += (count / 4) * 4;
+			for(count %= 4; count; count--)
+			{
+				*out++ = getU32(first++);
+			}
+		}
+
+		void fillU64(uint64_t first, uint64_t* out, size_t count) const
+		{
+			if(count && (first % 2))
+			{
+				*out++ = getU64(first++);
+				count--;
+			}
+			uint32_t words[CHUNK_BLOCKS * 4];
+			while(count >= 2)
+			{
+				const size_t blocks = count / 2 < CHUNK_BLOCKS ? count / 2 : CHUNK_BLOCKS;
+				Philox4x32::generateBlocks(first / 2, blocks, key, words);
+				for(size_t j = 0; j < 2 * blocks; j++)
+				{
+					out[j] = (uint64_t(words[2 * j + 1]) << 32) | words[2 * j];
+				}
+				out += 2 * blocks;
+				first += 2 * blocks;
+				count -= 2 * blocks;
+			}
+			if(count)
+			{
+				*out = getU64(first);
+			}
+		}
+
+		void fillDouble(uint64_t first, double* out, size_t count) const
+		{
+			uint64_t bits[CHUNK_BLOCKS * 2];
+			while(count)
+			{
+				const size_t n = count < CHUNK_BLOCKS * 2 ? count : CHUNK_BLOCKS * 2;
+				fillU64(first, bits, n);
+				for(size_t j = 0; j < n; j++)
+				{
+					out[j] = toDouble(bits[j]);
+				}
+				out += n;
+				first += n;
+				count -= n;
+			}
+		}
+
+		void fillFloat(uint64_t first, float* out, size_t count) const
+		{
+			uint32_t bits[CHUNK_BLOCKS * 4];
+			while(count)
+			{
+				const size_t n = count < CHUNK_BLOCKS * 4 ? count : CHUNK_BLOCKS * 4;
+				fillU32(first, bits, n);
+				for(size_t j = 0; j < n; j++)
+				{
+					out[j] = toFloat(bits[j]);
+				}
+				out += n;
+				first += n;
+				count -= n;
+			}
+		}
+
+		PhiloxEngine engine(uint64_t stream) const
+		{
+			return PhiloxEngine((uint64_t(key.v[1]) << 32) | key.v[0], stream + 1);
+		}
+	};
+
+	inline uint64_t counterRandom(uint64_t seed, uint64_t i)
+	{
+		return CounterRandom(seed).getU64(i);
+	}
+}
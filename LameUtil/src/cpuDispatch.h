@@ -0,0 +1,310 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <atomic>
+#include <string>
+#include <utility>
+#include "benchmark.h"
+
+#if !defined(LAME_DISABLE_CPU_DISPATCH) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) \
+	&& (defined(__GNUC__) || defined(_MSC_VER))
+#define LAME_CPU_DISPATCH 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/*
+Runtime CPU dispatch for the SIMD kernels of the library.
+
+One portable binary contains a build of every hot kernel for each instruction set level. The CPU is queried once
+(cpuid and xgetbv, so the operating system has to save the wider registers as well) and every call goes to the
+variant of the highest level the CPU supports. Variants are compiled with target attributes on GCC and Clang, MSVC
+accepts the intrinsics without them, so no per file compiler flags are needed.
+
+	Isa::Scalar  - plain C++, the fallback on every platform
+	Isa::SSE42   - SSE2 up to SSE4.2 (Nehalem and later)
+	Isa::AVX2    - AVX2 and FMA (Haswell, Zen and later)
+	Isa::AVX512  - AVX-512 F, BW, DQ and VL (Skylake-SP, Ice Lake, Zen 4 and later)
+
+Dispatched at the moment: the Philox block generation of CounterRandom (fillU32, fillU64, fillFloat, fillDouble) and
+the float kernels norm, normalize, distance and sqrdistance of VecArray. All variants return identical results.
+
+Not dispatched, these use the level the compiler targets:
+	VecArray add, sub, scale and dot   - one pass through memory, SSE2 already reaches the memory bandwidth
+	VecArray fastNormalize             - rsqrtps estimates differ between CPU vendors, results are never identical anyway
+	VecArray kernels of double         - only the float kernels have dispatched variants so far
+	vecCompact half conversions        - F16C with -mf16c, the exact scalar conversion otherwise
+	spatialSort Morton codes           - BMI2 pdep with -mbmi2, pdep is microcoded and slow on Zen 1 and 2
+
+Without dispatch (other compilers or architectures, or LAME_DISABLE_CPU_DISPATCH defined before the first include) the
+kernels use the best level the compiler targets, eg. -mavx2, and activeIsa() reports that level.
+
+
+Isa detectedIsa()
+The highest level supported by the CPU and the operating system, detected on the first call.
+
+Isa activeIsa()
+The level the kernels currently use. It starts at the detected level, or at the level named by the environment
+variable LAME_ISA (scalar, sse42, avx2 or avx512) if that is lower.
+
+Isa forceIsa(Isa isa) / void resetIsa()
+Forces all kernels to a lower level, eg. for testing the variants on one machine, and returns the level actually set
+(never above the detected one). resetIsa() returns to the detected level. Calls in progress on other threads finish
+with the variant they started with.
+
+const char* isaName(Isa isa)
+
+Dispatch<F>(F* scalar, F* sse42, F* avx2, F* avx512)
+A table of the variants of a kernel with the signature F, nullptr for levels without a variant of their own (the next
+lower one is used). operator() calls the variant for activeIsa(), get(isa) returns the one used for isa.
+
+void benchmarkIsas(const std::string& name, F f, int repeats = 1)
+Calls f() repeats times for every level up to detectedIsa() and prints the time of each with BenchTimer.
+
+
+Example:
+
+lameutil::CounterRandom rg(42);
+std::vector<float> out(1 << 24);
+lameutil::benchmarkIsas("philox fillFloat", [&]() { rg.fillFloat(0, out.data(), out.size()); }, 10);
+//Timer philox fillFloat [scalar]: 490 ms
+//Timer philox fillFloat [sse4.2]: 430 ms
+//...
+
+Timings, single core, same binary built with plain -O2, scalar / sse4.2 / avx2 / avx512:
+	CounterRandom::fillFloat, 10^8 values     ~295 ms / ~260 ms / ~140 ms / ~80 ms
+	VecArray<3, float> distance, 10^8 points  ~115 ms / ~40 ms / ~35 ms / ~30 ms (memory bound from AVX2 on)
+	VecArray<3, float> normalize, 10^8 points ~270 ms / ~70 ms / ~35 ms / ~27 ms
+*/
+
+#if LAME_CPU_DISPATCH && !(defined(_MSC_VER) && !defined(__clang__))
+#define LAME_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define LAME_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define LAME_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")))
+#else
+#define LAME_TARGET_SSE42
+#define LAME_TARGET_AVX2
+#define LAME_TARGET_AVX512
+#endif
+
+//floating point kernels which have to round the same on every level, GCC would otherwise fuse multiply and add where FMA is available
+#if defined(__GNUC__) && !defined(__clang__)
+#define LAME_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define LAME_NO_CONTRACT
+#endif
+
+//which variants can be compiled, all of them with dispatch, otherwise the ones the compiler targets
+#if LAME_CPU_DISPATCH || defined(__SSE4_2__)
+#define LAME_ISA_SSE42 1
+#endif
+#if LAME_CPU_DISPATCH || (defined(__AVX2__) && defined(__FMA__))
+#define LAME_ISA_AVX2 1
+#endif
+#if LAME_CPU_DISPATCH || (defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512DQ__) && defined(__AVX512VL__))
+#define LAME_ISA_AVX512 1
+#endif
+#if !LAME_CPU_DISPATCH && (LAME_ISA_SSE42 || LAME_ISA_AVX2 || LAME_ISA_AVX512)
+#include <immintrin.h>
+#endif
+
+namespace lameutil
+{
+	enum class Isa : int
+	{
+		Scalar = 0,
+		SSE42 = 1,
+		AVX2 = 2,
+		AVX512 = 3
+	};
+
+	inline const char* isaName(Isa isa)
+	{
+		static const char* names[] = {"scalar", "sse4.2", "avx2", "avx512"};
+		return names[(int)isa];
+	}
+
+	namespace detail
+	{
+		constexpr int isaCount = 4;
+
+#if LAME_CPU_DISPATCH
+		inline void cpuid(unsigned leaf, unsigned sub, unsigned r[4])
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			__cpuidex((int*)r, (int)leaf, (int)sub);
+#else
+			__cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+		}
+
+		inline unsigned long long xgetbv0()
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			return _xgetbv(0);
+#else
+			unsigned lo, hi;
+			__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			return ((unsigned long long)hi << 32) | lo;
+#endif
+		}
+
+		inline Isa queryIsa()
+		{
+			unsigned r[4];
+			cpuid(0, 0, r);
+			const unsigned maxLeaf = r[0];
+			if(maxLeaf < 1)
+			{
+				return Isa::Scalar;
+			}
+			cpuid(1, 0, r);
+			const unsigned ecx1 = r[2], edx1 = r[3];
+			const bool sse42 = (edx1 >> 26 & 1) && (ecx1 >> 19 & 1) && (ecx1 >> 20 & 1);
+			if(!sse42)
+			{
+				return Isa::Scalar;
+			}
+			//the operating system has to save the ymm (and zmm) state on context switches
+			const bool osxsave = ecx1 >> 27 & 1;
+			const unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+			if(maxLeaf < 7 || !(ecx1 >> 28 & 1) || !(ecx1 >> 12 & 1) || (xcr0 & 0x6) != 0x6)
+			{
+				return Isa::SSE42;
+			}
+			cpuid(7, 0, r);
+			const unsigned ebx7 = r[1];
+			if(!(ebx7 >> 5 & 1))
+			{
+				return Isa::SSE42;
+			}
+			const bool avx512 = (ebx7 >> 16 & 1) && (ebx7 >> 17 & 1) && (ebx7 >> 30 & 1) && (ebx7 >> 31 & 1) && (xcr0 & 0xe6) == 0xe6;
+			return avx512 ? Isa::AVX512 : Isa::AVX2;
+		}
+#else
+		inline Isa queryIsa()
+		{
+#if LAME_ISA_AVX512
+			return Isa::AVX512;
+#elif LAME_ISA_AVX2
+			return Isa::AVX2;
+#elif LAME_ISA_SSE42
+			return Isa::SSE42;
+#else
+			return Isa::Scalar;
+#endif
+		}
+#endif
+
+		inline Isa environmentIsa(Isa detected)
+		{
+			const char* env = std::getenv("LAME_ISA");
+			for(int i = 0; env && i < (int)detected; i++)
+			{
+				if(std::strcmp(env, isaName((Isa)i)) == 0 || (i == 1 && std::strcmp(env, "sse42") == 0))
+				{
+					return (Isa)i;
+				}
+			}
+			return detected;
+		}
+	}
+
+	inline Isa detectedIsa()
+	{
+		static const Isa isa = detail::queryIsa();
+		return isa;
+	}
+
+	namespace detail
+	{
+		inline std::atomic<int>& activeIsaSlot()
+		{
+			static std::atomic<int> slot{(int)environmentIsa(detectedIsa())};
+			return slot;
+		}
+	}
+
+	inline Isa activeIsa()
+	{
+		return (Isa)detail::activeIsaSlot().load(std::memory_order_relaxed);
+	}
+
+	inline Isa forceIsa(Isa isa)
+	{
+		const Isa set = (int)isa < (int)detectedIsa() ? isa : detectedIsa();
+		detail::activeIsaSlot().store((int)set, std::memory_order_relaxed);
+		return set;
+	}
+
+	inline void resetIsa()
+	{
+		forceIsa(detectedIsa());
+	}
+
+	template <typename F>
+	class Dispatch
+	{
+		F* table[detail::isaCount];
+
+	public:
+		Dispatch(F* scalar, F* sse42, F* avx2, F* avx512) : table{scalar, sse42, avx2, avx512}
+		{
+			assert(scalar);
+			for(int i = 1; i < detail::isaCount; i++)
+			{
+				table[i] = table[i] ? table[i] : table[i - 1];
+			}
+		}
+
+		F* get(Isa isa) const
+		{
+			return table[(int)isa];
+		}
+
+		template <typename... Args>
+		auto operator()(Args&&... args) const -> decltype(std::declval<F*>()(std::forward<Args>(args)...))
+		{
+			return table[(int)activeIsa()](std::forward<Args>(args)...);
+		}
+	};
+
+	template <typename F>
+	void benchmarkIsas(const std::string& name, F f, int repeats = 1)
+	{
+		const Isa previous = activeIsa();
+		for(int i = 0; i <= (int)detectedIsa(); i++)
+		{
+			forceIsa((Isa)i);
+			f();
+			BenchTimer timer(name + " [" + isaName((Isa)i) + "]");
+			for(int r = 0; r < repeats; r++)
+			{
+				f();
+			}
+		}
+		forceIsa(previous);
+	}
+}
+
+//the variant macros for Dispatch arguments, nullptr for variants which are not compiled
+#if LAME_ISA_SSE42
+#define LAME_IF_SSE42(f) f
+#else
+#define LAME_IF_SSE42(f) nullptr
+#endif
+#if LAME_ISA_AVX2
+#define LAME_IF_AVX2(f) f
+#else
+#define LAME_IF_AVX2(f) nullptr
+#endif
+#if LAME_ISA_AVX512
+#define LAME_IF_AVX512(f) f
+#else
+#define LAME_IF_AVX512(f) nullptr
+#endif
@@ -0,0 +1,897 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+/*
+Non-uniform random distributions that produce the same sequence with every standard library.
+
+The standard distributions are implementation defined, so std::normal_distribution gives different
+numbers with MSVC, libstdc++ and libc++. The samplers below only consume raw engine bits, the ziggurat
+tables are constants and exp/log are the library's own (fdlibm based, only IEEE exact +, -, *, / and sqrt),
+so together with a fixed engine (eg. lameutil::Xoshiro256 or lameutil::PhiloxEngine) the output does not
+depend on the standard library. The hot paths are a table lookup and a multiplication, exp/log are limited to
+the rare rejection branches of the ziggurats and to the gamma, Poisson and binomial samplers.
+The output is bit identical as long as the compiler does not fuse multiplications and additions: MSVC and
+Clang do not by default, GCC does when FMA is enabled (-mfma, -march=native), build with -ffp-contract=off
+there.
+
+Every distribution works with any standard conforming engine (use rg.engine() for an EasyRandom)
+and offers a bulk fill variant:
+
+	result_type operator()(Engine& g)
+	void fill(Engine& g, result_type* out, size_t count)
+
+
+NormalDistribution(double mean = 0, double stddev = 1)
+Ziggurat method with 256 layers (Marsaglia & Tsang, Doornik). ~99% of the samples cost one 64 bit draw.
+
+ExponentialDistribution(double lambda = 1)
+Ziggurat method with 256 layers.
+
+GammaDistribution(double alpha = 1, double beta = 1)
+Marsaglia & Tsang's squeeze method, beta is the scale parameter.
+
+PoissonDistribution(double mean = 1)
+Sequential inversion for small means and Hoermann's transformed rejection (PTRS) for mean >= 10.
+
+BinomialDistribution(int64_t n = 1, double p = 0.5)
+Sequential inversion for small n * min(p, 1 - p) and Hoermann's transformed rejection (BTRS) otherwise.
+
+
+Example:
+
+lameutil::Xoshiro256 engine(42);
+lameutil::NormalDistribution normal(5.0, 2.0);
+double x = normal(engine);
+std::vector<double> v(1000);
+normal.fill(engine, v.data(), v.size());
+
+*/
+
+namespace lameutil
+{
+	namespace detail
+	{
+		//64 uniformly distributed bits from any engine
+		template <typename Engine>
+		inline uint64_t randomBits64(Engine& g)
+		{
+			typedef typename Engine::result_type R;
+			constexpr uint64_t range = (uint64_t)(Engine::max() - Engine::min());
+			if constexpr(range == std::numeric_limits<uint64_t>::max())
+			{
+				return (uint64_t)(g() - Engine::min());
+			}
+			else if constexpr(range == 0xffffffffULL)
+			{
+				const uint64_t lo = (uint64_t)(R)(g() - Engine::min());
+				return (uint64_t(g() - Engine::min()) << 32) | lo;
+			}
+			else
+			{
+				//engines with an odd range (eg. minstd_rand) are combined, keeping the low bits of each call
+				uint64_t ret = 0;
+				int bits = 0;
+				int step = 0;
+				while(((range + 1) >> (step + 1)) != 0 && step < 63)
+				{
+					step++;
+				}
+				while(bits < 64)
+				{
+					ret = (ret << step) | ((uint64_t)(g() - Engine::min()) & ((uint64_t(1) << step) - 1));
+					bits += step;
+				}
+				return ret;
+			}
+		}
+
+		//uniform double in [0, 1>
+		inline double toUnitDouble(uint64_t bits)
+		{
+			return (bits >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		//uniform double in <0, 1>, safe to take the logarithm of
+		inline double toOpenUnitDouble(uint64_t bits)
+		{
+			return ((bits >> 12) + 0.5) * (1.0 / 4503599627370496.0);
+		}
+
+		inline uint64_t doubleBits(double x)
+		{
+			uint64_t bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			return bits;
+		}
+
+		inline double bitsDouble(uint64_t bits)
+		{
+			double x;
+			std::memcpy(&x, &bits, sizeof(x));
+			return x;
+		}
+
+		//x * 2^n
+		inline double scale2(double x, int n)
+		{
+			if(n > 1023)
+			{
+				x *= 0x1p1023;
+				n -= 1023;
+				n = n > 1023 ? 1023 : n;
+			}
+			else if(n < -1022)
+			{
+				//two steps keep the rounding of subnormal results single
+				x *= 0x1p-1022 * 0x1p53;
+				n += 1022 - 53;
+				n = n < -1022 ? -1022 : n;
+			}
+			return x * bitsDouble((uint64_t)(0x3ff + n) << 52);
+		}
+
+		//natural logarithm with the same result on every platform (fdlibm, < 1 ulp)
+		inline double portableLog(double x)
+		{
+			const double ln2Hi = 6.93147180369123816490e-01, ln2Lo = 1.90821492927058770002e-10;
+			const double lg1 = 6.666666666666735130e-01, lg2 = 3.999999999940941908e-01;
+			const double lg3 = 2.857142874366239149e-01, lg4 = 2.222219843214978396e-01;
+			const double lg5 = 1.818357216161805012e-01, lg6 = 1.531383769920937332e-01;
+			const double lg7 = 1.479819860511658591e-01;
+
+			uint64_t bits = doubleBits(x);
+			uint32_t hx = (uint32_t)(bits >> 32);
+			int k = 0;
+			if(hx < 0x00100000 || (hx >> 31))
+			{
+				if((bits << 1) == 0)
+				{
+					return -std::numeric_limits<double>::infinity();
+				}
+				if(hx >> 31)
+				{
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				//subnormal
+				k -= 54;
+				x *= 0x1p54;
+				bits = doubleBits(x);
+				hx = (uint32_t)(bits >> 32);
+			}
+			else if(hx >= 0x7ff00000)
+			{
+				return x + x;
+			}
+			else if(hx == 0x3ff00000 && (uint32_t)bits == 0)
+			{
+				return 0;
+			}
+
+			//x = 2^k * m with m in [sqrt(2) / 2, sqrt(2)>
+			hx += 0x3ff00000 - 0x3fe6a09e;
+			k += (int)(hx >> 20) - 0x3ff;
+			hx = (hx & 0x000fffff) + 0x3fe6a09e;
+			x = bitsDouble((uint64_t)hx << 32 | (bits & 0xffffffff));
+
+			const double f = x - 1.0;
+			const double hfsq = 0.5 * f * f;
+			const double s = f / (2.0 + f);
+			const double z = s * s;
+			const double w = z * z;
+			const double t1 = w * (lg2 + w * (lg4 + w * lg6));
+			const double t2 = z * (lg1 + w * (lg3 + w * (lg5 + w * lg7)));
+			const double r = t2 + t1;
+			const double dk = k;
+			return s * (hfsq + r) + dk * ln2Lo - hfsq + f + dk * ln2Hi;
+		}
+
+		//e^x with the same result on every platform (fdlibm, < 1 ulp)
+		inline double portableExp(double x)
+		{
+			const double ln2Hi = 6.93147180369123816490e-01, ln2Lo = 1.90821492927058770002e-10;
+			const double invLn2 = 1.44269504088896338700e+00;
+			const double p1 = 1.66666666666666019037e-01, p2 = -2.77777777770155933842e-03;
+			const double p3 = 6.61375632143793436117e-05, p4 = -1.65339022054652515390e-06;
+			const double p5 = 4.13813679705723846039e-08;
+
+			const uint32_t hx = (uint32_t)(doubleBits(x) >> 32) & 0x7fffffff;
+			const bool negative = x < 0;
+			if(hx >= 0x4086232b)
+			{
+				//|x| >= 708.39 or NaN
+				if(x != x)
+				{
+					return x;
+				}
+				if(x > 709.782712893383973096)
+				{
+					return std::numeric_limits<double>::infinity();
+				}
+				if(x < -745.13321910194110842)
+				{
+					return 0;
+				}
+			}
+
+			int k;
+			double hi, lo;
+			if(hx > 0x3fd62e42)
+			{
+				//|x| > ln2 / 2, x = k * ln2 + r with |r| <= ln2 / 2
+				k = hx >= 0x3ff0a2b2 ? (int)(invLn2 * x + (negative ? -0.5 : 0.5)) : (negative ? -1 : 1);
+				hi = x - k * ln2Hi;
+				lo = k * ln2Lo;
+				x = hi - lo;
+			}
+			else if(hx > 0x3e300000)
+			{
+				k = 0;
+				hi = x;
+				lo = 0;
+			}
+			else
+			{
+				return 1 + x;
+			}
+
+			const double xx = x * x;
+			const double c = x - xx * (p1 + xx * (p2 + xx * (p3 + xx * (p4 + xx * p5))));
+			const double y = 1 + (x * c / (2 - c) - lo + hi);
+			return k == 0 ? y : scale2(y, k);
+		}
+
+		//x^y for x > 0
+		inline double portablePow(double x, double y)
+		{
+			return portableExp(y * portableLog(x));
+		}
+
+		//log(k!) - table for small k and Stirling's series for the rest
+		inline double logFactorial(int64_t k)
+		{
+			static const struct Table
+			{
+				double v[128];
+				Table()
+				{
+					v[0] = 0;
+					for(int i = 1; i < 128; i++)
+					{
+						v[i] = v[i - 1] + portableLog((double)i);
+					}
+				}
+			} table;
+
+			if(k < 128)
+			{
+				return table.v[k];
+			}
+			const double x = (double)k + 1;
+			const double ix2 = 1.0 / (x * x);
+			return (x - 0.5) * portableLog(x) - x + 0.91893853320467274178 + (1.0 / 12.0 - ix2 * (1.0 / 360.0 - ix2 * (1.0 / 1260.0))) / x;
+		}
+
+		//layer tables of a 256 layer ziggurat for a monotone decreasing density f
+		struct ZigguratTables
+		{
+			double x[257];
+			double ratio[256];
+
+			explicit ZigguratTables(const double* layers)
+			{
+				for(int i = 0; i < 257; i++)
+				{
+					x[i] = layers[i];
+				}
+				for(int i = 0; i < 256; i++)
+				{
+					ratio[i] = x[i + 1] / x[i];
+				}
+			}
+		};
+
+		//layer edges of the normal ziggurat with R = 3.6541528853610088 and the layer area V = 0.00492867323399:
+		//x[0] = V / f(R), x[1] = R, x[i] = f^-1(V / x[i - 1] + f(x[i - 1])), as constants so they are the same on every
+		//platform
+		inline constexpr double zigguratNormal[257] =
+		{
+			0x1.f493b78164498p+1, 0x1.d3bb48209ad33p+1, 0x1.b981f3878f995p+1, 0x1.a8fdc7894718cp+1,
+			0x1.9cbee014050dfp+1, 0x1.92ee0946f3d1ap+1, 0x1.8ab0fbfaa7412p+1, 0x1.839030529e9c6p+1,
+			0x1.7d42df4d6c5c3p+1, 0x1.779955608fd5bp+1, 0x1.72728f05f70d7p+1, 0x1.6db6b8d09d896p+1,
+			0x1.69540be9fdbedp+1, 0x1.653ce7b0060dfp+1, 0x1.61669cf86140fp+1, 0x1.5dc8a243ac693p+1,
+			0x1.5a5c08b718342p+1, 0x1.571b1a94ad95ap+1, 0x1.54011523a7359p+1, 0x1.5109f53e9a131p+1,
+			0x1.4e3250dcd7dccp+1, 0x1.4b7739d6b4eccp+1, 0x1.48d62759c383dp+1, 0x1.464ce44a72e74p+1,
+			0x1.43d98155452d1p+1, 0x1.417a49cb9d9f6p+1, 0x1.3f2dbaa60e871p+1, 0x1.3cf27b316f883p+1,
+			0x1.3ac7570ae7cb8p+1, 0x1.38ab3925634a9p+1, 0x1.369d27a339bc1p+1, 0x1.349c405ae0606p+1,
+			0x1.32a7b5e6897e9p+1, 0x1.30becd256a217p+1, 0x1.2ee0db1a96c02p+1, 0x1.2d0d43196ce88p+1,
+			0x1.2b4375329fd27p+1, 0x1.2982ecd770131p+1, 0x1.27cb2faa84bcbp+1, 0x1.261bcc7764b62p+1,
+			0x1.24745a4ac8e8bp+1, 0x1.22d477a6fc63bp+1, 0x1.213bc9d04beb3p+1, 0x1.1fa9fc2e2cb18p+1,
+			0x1.1e1ebfbe4a036p+1, 0x1.1c99ca9719877p+1, 0x1.1b1ad777f2157p+1, 0x1.19a1a564edd5ap+1,
+			0x1.182df74d203f5p+1, 0x1.16bf93b9de06ep+1, 0x1.1556448601f9dp+1, 0x1.13f1d69c3fab5p+1,
+			0x1.129219bbb4e64p+1, 0x1.1136e04206156p+1, 0x1.0fdffefa690b2p+1, 0x1.0e8d4cf115675p+1,
+			0x1.0d3ea34aa2df9p+1, 0x1.0bf3dd1eec4f7p+1, 0x1.0aacd7571b15ap+1, 0x1.0969708e892dp+1,
+			0x1.082988f631e79p+1, 0x1.06ed023a716bp+1, 0x1.05b3bf6ada3acp+1, 0x1.047da4e3ee5dbp+1,
+			0x1.034a983a8f2a6p+1, 0x1.021a8028fb929p+1, 0x1.00ed447d3903dp+1, 0x1.ff859c118d567p+0,
+			0x1.fd360d22fc6aep+0, 0x1.faebb187101b4p+0, 0x1.f8a6604897644p+0, 0x1.f665f20c8dff6p+0,
+			0x1.f42a40fb72bc7p+0, 0x1.f1f328ac23146p+0, 0x1.efc086101ca9bp+0, 0x1.ed923761084f7p+0,
+			0x1.eb681c0f74c9p+0, 0x1.e94214b2a9c5cp+0, 0x1.e72002f97db41p+0, 0x1.e501c99c1ae6fp+0,
+			0x1.e2e74c4ea23a7p+0, 0x1.e0d06fb49ae98p+0, 0x1.debd195520a7ep+0, 0x1.dcad2f8fc252p+0,
+			0x1.daa0999204a4dp+0, 0x1.d8973f4d7d74dp+0, 0x1.d691096e7cc94p+0, 0x1.d48de1533a181p+0,
+			0x1.d28db1037ca23p+0, 0x1.d0906328b6a39p+0, 0x1.ce95e3068bacap+0, 0x1.cc9e1c73bb0eap+0,
+			0x1.caa8fbd367ccdp+0, 0x1.c8b66e0eb8p+0, 0x1.c6c6608ec60b5p+0, 0x1.c4d8c136de693p+0,
+			0x1.c2ed7e5f05369p+0, 0x1.c10486cebefa2p+0, 0x1.bf1dc9b81874ap+0, 0x1.bd3936b2e992ep+0,
+			0x1.bb56bdb84fdbep+0, 0x1.b9764f1e5cf51p+0, 0x1.b797db93f6101p+0, 0x1.b5bb541ce14a1p+0,
+			0x1.b3e0aa0dfe361p+0, 0x1.b207cf09a6f7ep+0, 0x1.b030b4fc378p+0, 0x1.ae5b4e18b89dep+0,
+			0x1.ac878cd5acc36p+0, 0x1.aab563e9fc731p+0, 0x1.a8e4c64a00726p+0, 0x1.a715a724a7f4dp+0,
+			0x1.a547f9e0b90efp+0, 0x1.a37bb21a29d81p+0, 0x1.a1b0c39f90b75p+0, 0x1.9fe7226faa6eap+0,
+			0x1.9e1ec2b6f486dp+0, 0x1.9c5798cd5ad43p+0, 0x1.9a919933f6d92p+0, 0x1.98ccb892dfdbfp+0,
+			0x1.9708ebb70a936p+0, 0x1.954627903758cp+0, 0x1.9384612eeddb8p+0, 0x1.91c38dc2855bcp+0,
+			0x1.9003a297387bcp+0, 0x1.8e44951443c0ap+0, 0x1.8c865aba0de35p+0, 0x1.8ac8e92059192p+0,
+			0x1.890c35f47c831p+0, 0x1.875036f7a4f7ep+0, 0x1.8594e1fd1c628p+0, 0x1.83da2ce896f32p+0,
+			0x1.82200dac85645p+0, 0x1.80667a486b99ep+0, 0x1.7ead68c73ae15p+0, 0x1.7cf4cf3daf1d9p+0,
+			0x1.7b3ca3c8ae294p+0, 0x1.7984dc8ba8bcbp+0, 0x1.77cd6faefc22dp+0, 0x1.7616535e540adp+0,
+			0x1.745f7dc70bc13p+0, 0x1.72a8e5168e1a6p+0, 0x1.70f27f78b3573p+0, 0x1.6f3c43161c483p+0,
+			0x1.6d86261289f28p+0, 0x1.6bd01e8b30f36p+0, 0x1.6a1a229507dcfp+0, 0x1.6864283b0fbf7p+0,
+			0x1.66ae257c960d3p+0, 0x1.64f8104b6f00cp+0, 0x1.6341de8a27a41p+0, 0x1.618b860a2e8ffp+0,
+			0x1.5fd4fc89f270fp+0, 0x1.5e1e37b2f5545p+0, 0x1.5c672d17d3b48p+0, 0x1.5aafd2323e2fbp+0,
+			0x1.58f81c60e4c4cp+0, 0x1.574000e552644p+0, 0x1.558774e1b7925p+0, 0x1.53ce6d56a2c3dp+0,
+			0x1.5214df20a50d8p+0, 0x1.505abef5e1a6dp+0, 0x1.4ea0016386a9cp+0, 0x1.4ce49acb2d5fdp+0,
+			0x1.4b287f6020506p+0, 0x1.496ba3248525ep+0, 0x1.47adf9e6685eap+0, 0x1.45ef773ca8993p+0,
+			0x1.44300e83bf25ap+0, 0x1.426fb2da63591p+0, 0x1.40ae571e05f24p+0, 0x1.3eebede721aacp+0,
+			0x1.3d2869855dd8p+0, 0x1.3b63bbfb7fc17p+0, 0x1.399dd6fb270e9p+0, 0x1.37d6abe05165dp+0,
+			0x1.360e2baca1034p+0, 0x1.3444470261b6ap+0, 0x1.3278ee1f4755fp+0, 0x1.30ac10d6e0469p+0,
+			0x1.2edd9e8cb647fp+0, 0x1.2d0d862e172a1p+0, 0x1.2b3bb62b7e88p+0, 0x1.29681c7199017p+0,
+			0x1.2792a661d8bcdp+0, 0x1.25bb40ca92399p+0, 0x1.23e1d7de97a07p+0, 0x1.2206572c47d17p+0,
+			0x1.2028a9940561p+0, 0x1.1e48b93e088dcp+0, 0x1.1c666f8f7deb3p+0, 0x1.1a81b51ee20a3p+0,
+			0x1.189a71a788c7ep+0, 0x1.16b08bfc3d191p+0, 0x1.14c3e9f8e41d8p+0, 0x1.12d470730bf74p+0,
+			0x1.10e203294c4bdp+0, 0x1.0eec84b15b64dp+0, 0x1.0cf3d664b796dp+0, 0x1.0af7d84bc0d06p+0,
+			0x1.08f8690719efdp+0, 0x1.06f565b7249f9p+0, 0x1.04eea9e164ed4p+0, 0x1.02e40f5393759p+0,
+			0x1.00d56e041db89p+0, 0x1.fd8537df97991p-1, 0x1.f956d9e87202bp-1, 0x1.f51f654d83c88p-1,
+			0x1.f0de784efa595p-1, 0x1.ec93abdf8c395p-1, 0x1.e83e93379ad08p-1, 0x1.e3debb5d2292dp-1,
+			0x1.df73aa9f0ae8dp-1, 0x1.dafce0022edeep-1, 0x1.d679d29e3510dp-1, 0x1.d1e9f0e7fe5f7p-1,
+			0x1.cd4c9fe7151cap-1, 0x1.c8a13a531630bp-1, 0x1.c3e70f95872ep-1, 0x1.bf1d62abea23bp-1,
+			0x1.ba4368e51bb3p-1, 0x1.b5584874191dap-1, 0x1.b05b16d127fd5p-1, 0x1.ab4ad6e0f24bap-1,
+			0x1.a62676d76d6f5p-1, 0x1.a0eccdca3ab98p-1, 0x1.9b9c98e37c43bp-1, 0x1.96347822b1818p-1,
+			0x1.90b2ea94dc2a8p-1, 0x1.8b1649e7a632cp-1, 0x1.855cc5341f023p-1, 0x1.7f845ad45d397p-1,
+			0x1.798ad10b200fp-1, 0x1.736dad345c6b6p-1, 0x1.6d2a291feca73p-1, 0x1.66bd261a2377ep-1,
+			0x1.60231cfd82f9bp-1, 0x1.59580a70673c9p-1, 0x1.5257562196c1cp-1, 0x1.4b1bb363c898dp-1,
+			0x1.439ef8dfe170ap-1, 0x1.3bd9ec1a11c06p-1, 0x1.33c3fc055e9edp-1, 0x1.2b52e38621b3p-1,
+			0x1.227a28f78456ap-1, 0x1.192a6973f450ap-1, 0x1.0f5053b004b4ep-1, 0x1.04d32278c832ep-1,
+			0x1.f32482d4807a6p-2, 0x1.dac2f5a6f312p-2, 0x1.c004d2f328d93p-2, 0x1.a230c2e46389ep-2,
+			0x1.801fce827fac5p-2, 0x1.57cb9383ae55p-2, 0x1.250af3c200a69p-2, 0x1.b8d0be3d69918p-3,
+			0x0p+0
+		};
+
+		//layer edges of the exponential ziggurat, R = 7.69711747013104972 and V = 0.0039496598225815571993
+		inline constexpr double zigguratExponential[257] =
+		{
+			0x1.164ec94bf5dc3p+3, 0x1.ec9d9297ebb83p+2, 0x1.bc39e51da71fcp+2, 0x1.9e9dc0d487b85p+2,
+			0x1.8939fe6f2ed19p+2, 0x1.78750d6eac62fp+2, 0x1.6aa676d4bbf72p+2, 0x1.5ee7ae17313d2p+2,
+			0x1.54ad83ccf73f5p+2, 0x1.4b9d7cd4751dp+2, 0x1.4379766e41361p+2, 0x1.3c14ec7c8b86p+2,
+			0x1.354ee27ccf75dp+2, 0x1.2f0e38a4411fp+2, 0x1.293f5ae49aaa5p+2, 0x1.23d2bb659919fp+2,
+			0x1.1ebbca0c9fa7cp+2, 0x1.19f03bcb3c2d6p+2, 0x1.156786775442ap+2, 0x1.111a8034392a6p+2,
+			0x1.0d031785d48ap+2, 0x1.091c1cdcba54ep+2, 0x1.056118bf58eefp+2, 0x1.01ce2b362ec2ep+2,
+			0x1.fcbfe43f6c6e6p+1, 0x1.f626e9791f7a7p+1, 0x1.efcc26750ea4ap+1, 0x1.e9aaf2af383c1p+1,
+			0x1.e3bf26e19096p+1, 0x1.de050af4ef19fp+1, 0x1.d87946fec3becp+1, 0x1.d318d6b2738c5p+1,
+			0x1.cde0fecf2a97fp+1, 0x1.c8cf442c8c8f3p+1, 0x1.c3e1641c2e0a6p+1, 0x1.bf154de4bef76p+1,
+			0x1.ba691d276da5dp+1, 0x1.b5db15091ea0ep+1, 0x1.b1699c003b608p+1, 0x1.ad13382d845c3p+1,
+			0x1.a8d68c2ad86e8p+1, 0x1.a4b2543e84c3ap+1, 0x1.a0a563e49f177p+1, 0x1.9caea3a24d9e9p+1,
+			0x1.98cd0f18d1ad7p+1, 0x1.94ffb34fc2a0dp+1, 0x1.9145ad2f37543p+1, 0x1.8d9e2823b3695p+1,
+			0x1.8a085ce695baap+1, 0x1.8683906687341p+1, 0x1.830f12cc0bec3p+1, 0x1.7faa3e96e1412p+1,
+			0x1.7c5477d1476d3p+1, 0x1.790d2b56b71f9p+1, 0x1.75d3ce2bd71c3p+1, 0x1.72a7dce5cd218p+1,
+			0x1.6f88db1f42507p+1, 0x1.6c7652f9a7b1ep+1, 0x1.696fd4a9748eep+1, 0x1.6674f60c3f431p+1,
+			0x1.63855247b2e93p+1, 0x1.60a0897081877p+1, 0x1.5dc640388bd9cp+1, 0x1.5af61fa38e106p+1,
+			0x1.582fd4c1b446p+1, 0x1.5573106f8a759p+1, 0x1.52bf871acaab1p+1, 0x1.5014f08b99508p+1,
+			0x1.4d7307b1cb127p+1, 0x1.4ad98a75da14cp+1, 0x1.4848398d39432p+1, 0x1.45bed851bc92cp+1,
+			0x1.433d2c9bd42f8p+1, 0x1.40c2fe9f5eeadp+1, 0x1.3e5018caddecfp+1, 0x1.3be447a8d8b83p+1,
+			0x1.397f59c345143p+1, 0x1.37211f88ca856p+1, 0x1.34c96b33bc965p+1, 0x1.327810b2aa7cfp+1,
+			0x1.302ce59265964p+1, 0x1.2de7c0e962d7p+1, 0x1.2ba87b445db5p+1, 0x1.296eee942532bp+1,
+			0x1.273af61c7daa6p+1, 0x1.250c6e6403bbap+1, 0x1.22e33524fe55p+1, 0x1.20bf293f0f4a2p+1,
+			0x1.1ea02aa9b3371p+1, 0x1.1c861a6782a5bp+1, 0x1.1a70da7a27821p+1, 0x1.18604dd6fae9ep+1,
+			0x1.1654585c404c1p+1, 0x1.144cdec6f3a2cp+1, 0x1.1249c6a92154bp+1, 0x1.104af660befcfp+1,
+			0x1.0e50550efcfb8p+1, 0x1.0c59ca900947p+1, 0x1.0a673f733c81ap+1, 0x1.08789cf3aad0fp+1,
+			0x1.068dccf1126dbp+1, 0x1.04a6b9e9224a3p+1, 0x1.02c34ef11391bp+1, 0x1.00e377af911d5p+1,
+			0x1.fe0e40add09d9p+0, 0x1.fa5c6b3efe1e6p+0, 0x1.f6b1498515ed1p+0, 0x1.f30cb6ea0bc81p+0,
+			0x1.ef6e8fc5b9169p+0, 0x1.ebd6b154a767ap+0, 0x1.e844f9af42381p+0, 0x1.e4b947c16a454p+0,
+			0x1.e1337b426509dp+0, 0x1.ddb374ad23581p+0, 0x1.da391538da50cp+0, 0x1.d6c43ed1ea401p+0,
+			0x1.d354d4130f2bp+0, 0x1.cfeab83ed7182p+0, 0x1.cc85cf395a56ep+0, 0x1.c925fd82323fep+0,
+			0x1.c5cb282eab1a7p+0, 0x1.c27534e42e02fp+0, 0x1.bf2409d2dfd87p+0, 0x1.bbd78db072612p+0,
+			0x1.b88fa7b324fb7p+0, 0x1.b54c3f8cf2543p+0, 0x1.b20d3d66e8bb6p+0, 0x1.aed289dcaadp+0,
+			0x1.ab9c0df81657bp+0, 0x1.a869b32d0f31p+0, 0x1.a53b63556c691p+0, 0x1.a21108ad0592ep+0,
+			0x1.9eea8dcdde952p+0, 0x1.9bc7ddac7035ep+0, 0x1.98a8e3940bbf5p+0, 0x1.958d8b235828bp+0,
+			0x1.9275c048e73e2p+0, 0x1.8f616f3fe1514p+0, 0x1.8c50848cc6095p+0, 0x1.8942ecfa40f55p+0,
+			0x1.86389596108e8p+0, 0x1.83316badfe62bp+0, 0x1.802d5ccce7278p+0, 0x1.7d2c56b7d17f9p+0,
+			0x1.7a2e476b1240cp+0, 0x1.77331d177d131p+0, 0x1.743ac61fa041dp+0, 0x1.714531150a9fcp+0,
+			0x1.6e524cb59a609p+0, 0x1.6b6207e8d3ce1p+0, 0x1.687451bd3ebfp+0, 0x1.65891965c9b8ep+0,
+			0x1.62a04e3731a2fp+0, 0x1.5fb9dfa56cf28p+0, 0x1.5cd5bd4119336p+0, 0x1.59f3d6b4e9cfap+0,
+			0x1.57141bc316f27p+0, 0x1.54367c42cb5f9p+0, 0x1.515ae81d900fcp+0, 0x1.4e814f4cb45ebp+0,
+			0x1.4ba9a1d6b18a5p+0, 0x1.48d3cfcc883c4p+0, 0x1.45ffc94716ca7p+0, 0x1.432d7e6466cdp+0,
+			0x1.405cdf44f09c4p+0, 0x1.3d8ddc08d336ep+0, 0x1.3ac064ccfeffcp+0, 0x1.37f469a851aefp+0,
+			0x1.3529daa8a1bap+0, 0x1.3260a7cfb7611p+0, 0x1.2f98c1103172p+0, 0x1.2cd2164a53b5dp+0,
+			0x1.2a0c9748bcda9p+0, 0x1.274833bd0189fp+0, 0x1.2484db3c2a329p+0, 0x1.21c27d3b10e04p+0,
+			0x1.1f01090a9c4ep+0, 0x1.1c406dd3d5281p+0, 0x1.19809a93d2394p+0, 0x1.16c17e1777ff9p+0,
+			0x1.140306f707dbcp+0, 0x1.114523917ac13p+0, 0x1.0e87c207a2f64p+0, 0x1.0bcad03710135p+0,
+			0x1.090e3bb4b007p+0, 0x1.0651f1c7276f5p+0, 0x1.0395df60db15fp+0, 0x1.00d9f119a3cd6p+0,
+			0x1.fc3c26504a99cp-1, 0x1.f6c462b57febp-1, 0x1.f14c6e2029499p-1, 0x1.ebd41e5e21b5dp-1,
+			0x1.e65b483cf103ep-1, 0x1.e0e1bf77c31f8p-1, 0x1.db6756a42905p-1, 0x1.d5ebdf1d86b87p-1,
+			0x1.d06f28ef0e6f4p-1, 0x1.caf102bc25ad4p-1, 0x1.c57139a70d298p-1, 0x1.bfef99359fe92p-1,
+			0x1.ba6beb33f8f83p-1, 0x1.b4e5f794c9795p-1, 0x1.af5d844f224c2p-1, 0x1.a9d255396d25bp-1,
+			0x1.a4442be148844p-1, 0x1.9eb2c75ff03b8p-1, 0x1.991de42ad1332p-1, 0x1.93853bdfda23dp-1,
+			0x1.8de8850d0c523p-1, 0x1.884772f2be1e5p-1, 0x1.82a1b53fed593p-1, 0x1.7cf6f7c7e816cp-1,
+			0x1.7746e2307796dp-1, 0x1.71911797990b5p-1, 0x1.6bd5362faa93ep-1, 0x1.6612d6d0c68dap-1,
+			0x1.60498c7dd2ec8p-1, 0x1.5a78e3db8bef6p-1, 0x1.54a0629786f47p-1, 0x1.4ebf86bcd0b8dp-1,
+			0x1.48d5c5f35e70cp-1, 0x1.42e28ca706742p-1, 0x1.3ce53d121629ap-1, 0x1.36dd2e26d81fbp-1,
+			0x1.30c9aa526da45p-1, 0x1.2aa9ee1236804p-1, 0x1.247d26538ff28p-1, 0x1.1e426e93e49e1p-1,
+			0x1.17f8ceb4bdf9bp-1, 0x1.119f38749f5aap-1, 0x1.0b348479b80f7p-1, 0x1.04b76ed6a7553p-1,
+			0x1.fc4d25d683201p-2, 0x1.ef00ccf5f4fa3p-2, 0x1.e186678f17352p-2, 0x1.d3da24df17c2dp-2,
+			0x1.c5f7bd78c3f7fp-2, 0x1.b7da5dddda3b9p-2, 0x1.a97c8be5d51f8p-2, 0x1.9ad80552237c7p-2,
+			0x1.8be5954d36063p-2, 0x1.7c9cdda17d00ep-2, 0x1.6cf40f0a72bb2p-2, 0x1.5cdf89d024ab7p-2,
+			0x1.4c515c60bfe16p-2, 0x1.3b388fe3d6ebdp-2, 0x1.2980290da2625p-2, 0x1.170db24d6f662p-2,
+			0x1.03bf049c65c2dp-2, 0x1.decd8b76dbd7bp-3, 0x1.b38d1ef79b7aep-3, 0x1.85090fbc27a5ep-3,
+			0x1.522e6e54a2a4ep-3, 0x1.19335a95b8d8ep-3, 0x1.ad6b2495b4cc6p-4, 0x1.0589d8b5d408fp-4,
+			0x0p+0
+		};
+	}
+
+	class NormalDistribution
+	{
+	public:
+		typedef double result_type;
+
+		NormalDistribution(double mean = 0.0, double stddev = 1.0) : m_mean(mean), m_stddev(stddev)
+		{
+		}
+
+		double mean() const { return m_mean; }
+		double stddev() const { return m_stddev; }
+
+		template <typename Engine>
+		double operator()(Engine& g) const
+		{
+			return m_mean + m_stddev * standard(g, tables());
+		}
+
+		template <typename Engine>
+		void fill(Engine& g, double* out, size_t count) const
+		{
+			const detail::ZigguratTables& t = tables();
+			for(size_t i = 0; i < count; i++)
+			{
+				out[i] = m_mean + m_stddev * standard(g, t);
+			}
+		}
+
+		template <typename Engine>
+		static double standard(Engine& g)
+		{
+			return standard(g, tables());
+		}
+
+	private:
+		double m_mean, m_stddev;
+
+		static constexpr double R = 3.6541528853610088;
+
+		static const detail::ZigguratTables& tables()
+		{
+			static const detail::ZigguratTables t(detail::zigguratNormal);
+			return t;
+		}
+
+		template <typename Engine>
+		static double standard(Engine& g, const detail::ZigguratTables& t)
+		{
+			for(;;)
+			{
+				const uint64_t bits = detail::randomBits64(g);
+				const int i = (int)(bits & 0xff);
+				const double u = 2 * detail::toUnitDouble(bits) - 1;
+
+				if(std::fabs(u) < t.ratio[i])
+				{
+					return u * t.x[i];
+				}
+				if(i == 0)
+				{
+					//tail beyond R
+					double x, y;
+					do
+					{
+						x = detail::portableLog(detail::toOpenUnitDouble(detail::randomBits64(g))) / R;
+						y = detail::portableLog(detail::toOpenUnitDouble(detail::randomBits64(g)));
+					} while(-2 * y < x * x);
+					return u < 0 ? x - R : R - x;
+				}
+
+				const double x = u * t.x[i];
+				const double f0 = detail::portableExp(-0.5 * (t.x[i] * t.x[i] - x * x));
+				const double f1 = detail::portableExp(-0.5 * (t.x[i + 1] * t.x[i + 1] - x * x));
+				if(f1 + detail::toUnitDouble(detail::randomBits64(g)) * (f0 - f1) < 1.0)
+				{
+					return x;
+				}
+			}
+		}
+	};
+
+	class ExponentialDistribution
+	{
+	public:
+		typedef double result_type;
+
+		ExponentialDistribution(double lambda = 1.0) : m_lambda(lambda), m_scale(1.0 / lambda)
+		{
+		}
+
+		double lambda() const { return m_lambda; }
+
+		template <typename Engine>
+		double operator()(Engine& g) const
+		{
+			return m_scale * standard(g, tables());
+		}
+
+		template <typename Engine>
+		void fill(Engine& g, double* out, size_t count) const
+		{
+			const detail::ZigguratTables& t = tables();
+			for(size_t i = 0; i < count; i++)
+			{
+				out[i] = m_scale * standard(g, t);
+			}
+		}
+
+		template <typename Engine>
+		static double standard(Engine& g)
+		{
+			return standard(g, tables());
+		}
+
+	private:
+		double m_lambda, m_scale;
+
+		static constexpr double R = 7.69711747013104972;
+
+		static const detail::ZigguratTables& tables()
+		{
+			static const detail::ZigguratTables t(detail::zigguratExponential);
+			return t;
+		}
+
+		template <typename Engine>
+		static double standard(Engine& g, const detail::ZigguratTables& t)
+		{
+			for(;;)
+			{
+				const uint64_t bits = detail::randomBits64(g);
+				const int i = (int)(bits & 0xff);
+				const double u = detail::toUnitDouble(bits);
+
+				if(u < t.ratio[i])
+				{
+					return u * t.x[i];
+				}
+				if(i == 0)
+				{
+					//the tail of an exponential is an exponential shifted by R
+					return R - detail::portableLog(detail::toOpenUnitDouble(detail::randomBits64(g)));
+				}
+
+				const double x = u * t.x[i];
+				const double f0 = detail::portableExp(x - t.x[i]);
+				const double f1 = detail::portableExp(x - t.x[i + 1]);
+				if(f1 + detail::toUnitDouble(detail::randomBits64(g)) * (f0 - f1) < 1.0)
+				{
+					return x;
+				}
+			}
+		}
+	};
+
+	class GammaDistribution
+	{
+	public:
+		typedef double result_type;
+
+		GammaDistribution(double alpha = 1.0, double beta = 1.0) : m_alpha(alpha), m_beta(beta)
+		{
+			const double a = alpha < 1 ? alpha + 1 : alpha;
+			d = a - 1.0 / 3.0;
+			c = 1.0 / std::sqrt(9 * d);
+			invAlpha = 1.0 / alpha;
+		}
+
+		double alpha() const { return m_alpha; }
+		double beta() const { return m_beta; }
+
+		template <typename Engine>
+		double operator()(Engine& g) const
+		{
+			double ret = sample(g);
+			if(m_alpha < 1)
+			{
+				//Gamma(a) = Gamma(a + 1) * U^(1 / a)
+				ret *= detail::portablePow(detail::toOpenUnitDouble(detail::randomBits64(g)), invAlpha);
+			}
+			return ret * m_beta;
+		}
+
+		template <typename Engine>
+		void fill(Engine& g, double* out, size_t count) const
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				out[i] = (*this)(g);
+			}
+		}
+
+	private:
+		double m_alpha, m_beta;
+		double d, c, invAlpha;
+
+		template <typename Engine>
+		double sample(Engine& g) const
+		{
+			for(;;)
+			{
+				double x, v;
+				do
+				{
+					x = NormalDistribution::standard(g);
+					v = 1 + c * x;
+				} while(v <= 0);
+				v = v * v * v;
+				const double u = detail::toOpenUnitDouble(detail::randomBits64(g));
+				const double x2 = x * x;
+				if(u < 1 - 0.0331 * x2 * x2)
+				{
+					return d * v;
+				}
+				if(detail::portableLog(u) < 0.5 * x2 + d * (1 - v + detail::portableLog(v)))
+				{
+					return d * v;
+				}
+			}
+		}
+	};
+
+	class PoissonDistribution
+	{
+	public:
+		typedef int64_t result_type;
+
+		PoissonDistribution(double mean = 1.0) : m_mean(mean)
+		{
+			if(mean < INVERSION_LIMIT)
+			{
+				expMean = detail::portableExp(-mean);
+			}
+			else
+			{
+				const double slam = std::sqrt(mean);
+				logMean = detail::portableLog(mean);
+				b = 0.931 + 2.53 * slam;
+				a = -0.059 + 0.02483 * b;
+				logInvAlpha = detail::portableLog(1.1239 + 1.1328 / (b - 3.4));
+				vr = 0.9277 - 3.6224 / (b - 2);
+			}
+		}
+
+		double mean() const { return m_mean; }
+
+		template <typename Engine>
+		int64_t operator()(Engine& g) const
+		{
+			return m_mean < INVERSION_LIMIT ? inversion(g) : ptrs(g);
+		}
+
+		template <typename Engine>
+		void fill(Engine& g, int64_t* out, size_t count) const
+		{
+			if(m_mean < INVERSION_LIMIT)
+			{
+				for(size_t i = 0; i < count; i++)
+				{
+					out[i] = inversion(g);
+				}
+			}
+			else
+			{
+				for(size_t i = 0; i < count; i++)
+				{
+					out[i] = ptrs(g);
+				}
+			}
+		}
+
+	private:
+		static constexpr double INVERSION_LIMIT = 10.0;
+
+		double m_mean;
+		double expMean = 0, logMean = 0;
+		double a = 0, b = 0, logInvAlpha = 0, vr = 0;
+
+		template <typename Engine>
+		int64_t inversion(Engine& g) const
+		{
+			int64_t k = 0;
+			double p = expMean;
+			double s = p;
+			const double u = detail::toUnitDouble(detail::randomBits64(g));
+			while(u > s)
+			{
+				k++;
+				p *= m_mean / k;
+				s += p;
+				if(p < std::numeric_limits<double>::min())
+				{
+					//rounding left the cdf just below u, the remaining mass is negligible
+					break;
+				}
+			}
+			return k;
+		}
+
+		template <typename Engine>
+		int64_t ptrs(Engine& g) const
+		{
+			for(;;)
+			{
+				const double u = detail::toUnitDouble(detail::randomBits64(g)) - 0.5;
+				const double v = detail::toOpenUnitDouble(detail::randomBits64(g));
+				const double us = 0.5 - std::fabs(u);
+				if(us == 0)
+				{
+					//u = -0.5 exactly, the transformation divides by us
+					continue;
+				}
+				const int64_t k = (int64_t)std::floor((2 * a / us + b) * u + m_mean + 0.43);
+
+				if(us >= 0.07 && v <= vr)
+				{
+					return k;
+				}
+				if(k < 0 || (us < 0.013 && v > us))
+				{
+					continue;
+				}
+				if(detail::portableLog(v) + logInvAlpha - detail::portableLog(a / (us * us) + b) <= -m_mean + k * logMean - detail::logFactorial(k))
+				{
+					return k;
+				}
+			}
+		}
+	};
+
+	class BinomialDistribution
+	{
+	public:
+		typedef int64_t result_type;
+
+		BinomialDistribution(int64_t n = 1, double p = 0.5) : m_n(n), m_p(p)
+		{
+			flipped = p > 0.5;
+			pp = flipped ? 1 - p : p;
+			const double q = 1 - pp;
+			useInversion = n * pp < INVERSION_LIMIT;
+			if(useInversion)
+			{
+				s = pp / q;
+				as = (n + 1) * s;
+				q0 = detail::portablePow(q, (double)n);
+			}
+			else
+			{
+				const double spq = std::sqrt(n * pp * q);
+				b = 1.15 + 2.53 * spq;
+				a = -0.0873 + 0.0248 * b + 0.01 * pp;
+				c = n * pp + 0.5;
+				alpha = (2.83 + 5.1 / b) * spq;
+				vr = 0.92 - 4.2 / b;
+				urvr = 0.86 * vr;
+				m = (int64_t)std::floor((n + 1) * pp);
+				lpq = detail::portableLog(pp / q);
+				h = detail::logFactorial(m) + detail::logFactorial(n - m);
+			}
+		}
+
+		int64_t n() const { return m_n; }
+		double p() const { return m_p; }
+
+		template <typename Engine>
+		int64_t operator()(Engine& g) const
+		{
+			const int64_t k = useInversion ? inversion(g) : btrs(g);
+			return flipped ? m_n - k : k;
+		}
+
+		template <typename Engine>
+		void fill(Engine& g, int64_t* out, size_t count) const
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				out[i] = (*this)(g);
+			}
+		}
+
+	private:
+		static constexpr double INVERSION_LIMIT = 14.0;
+
+		int64_t m_n;
+		double m_p;
+		bool flipped, useInversion;
+		double pp;
+		double s = 0, as = 0, q0 = 0;
+		double a = 0, b = 0, c = 0, alpha = 0, vr = 0, urvr = 0, lpq = 0, h = 0;
+		int64_t m = 0;
+
+		template <typename Engine>
+		int64_t inversion(Engine& g) const
+		{
+			for(;;)
+			{
+				double r = q0;
+				double u = detail::toUnitDouble(detail::randomBits64(g));
+				int64_t k = 0;
+				while(u > r)
+				{
+					u -= r;
+					k++;
+					if(k > m_n)
+						break;
+					r *= as / k - s;
+				}
+				if(k <= m_n)
+				{
+					return k;
+				}
+			}
+		}
+
+		template <typename Engine>
+		int64_t btrs(Engine& g) const
+		{
+			for(;;)
+			{
+				double v = detail::toUnitDouble(detail::randomBits64(g));
+				double u;
+				if(v <= urvr)
+				{
+					u = v / vr - 0.43;
+					return (int64_t)std::floor((2 * a / (0.5 - std::fabs(u)) + b) * u + c);
+				}
+				if(v >= vr)
+				{
+					u = detail::toUnitDouble(detail::randomBits64(g)) - 0.5;
+				}
+				else
+				{
+					u = v / vr - 0.93;
+					u = (u < 0 ? -0.5 : 0.5) - u;
+					v = detail::toUnitDouble(detail::randomBits64(g)) * vr;
+				}
+
+				const double us = 0.5 - std::fabs(u);
+				if(us == 0)
+				{
+					continue;
+				}
+				const int64_t k = (int64_t)std::floor((2 * a / us + b) * u + c);
+				if(k < 0 || k > m_n)
+				{
+					continue;
+				}
+				v = v * alpha / (a / (us * us) + b);
+				if(detail::portableLog(v) <= h - detail::logFactorial(k) - detail::logFactorial(m_n - k) + (k - m) * lpq)
+				{
+					return k;
+				}
+			}
+		}
+	};
+}
@@ -6,15 +6,25 @@ Class which enables easy generation of random integers and doubles.
 The class can be initialized and immediately used.
 
 
+EasyRandom is an alias for BasicEasyRandom<std::default_random_engine>.
+BasicEasyRandom<Engine> exposes the same interface on top of any standard conforming engine
+(eg. lameutil::Xoshiro256 from randomStreams.h).
+
 EasyRandom()
 Default constructor. Generates a seed automatically and uses it for further generation.
 
 EasyRandom(std::seed_seq& seed)
 Constructor which takes in a custom seed for generation.
 
+EasyRandom(const Engine& engine)
+Constructor which continues generation from an already seeded engine.
+
 void setSeed(std::seed_seq& seed)
 Set the seed of the entire class.
 
+Engine& engine()
+Access to the underlying engine, eg. for use with standard distributions.
+
 int getInt()
 Fuction which generates and returns an integer in the range [0, 100>
 
@@ -49,27 +59,38 @@ std::cout << rg.getDouble(5.0, 10.0) << std::endl;
 
 namespace lameutil
 {
-	class EasyRandom
+	template <typename Engine = std::default_random_engine>
+	class BasicEasyRandom
 	{
 	private:
-		std::default_random_engine generator;
+		Engine generator;
 
 	public:
-		EasyRandom()
+		typedef Engine engine_type;
+
+		BasicEasyRandom()
 		{
 			std::random_device rd;
-			generator = std::default_random_engine(rd());
+			generator = Engine(rd());
 		}
-		EasyRandom(std::seed_seq& seed)
+		BasicEasyRandom(std::seed_seq& seed)
 		{
 			setSeed(seed);
 		}
+		explicit BasicEasyRandom(const Engine& engine) : generator(engine)
+		{
+		}
 
 		void setSeed(std::seed_seq& seed)
 		{
 			generator.seed(seed);
 		}
 
+		Engine& engine()
+		{
+			return generator;
+		}
+
 		int getInt(int min, int max)
 		{
 			std::uniform_int_distribution<int> distrib;
@@ -119,4 +140,6 @@ namespace lameutil
 		}
 
 	};
+
+	typedef BasicEasyRandom<> EasyRandom;
 }
\ No newline at end of file
@@ -0,0 +1,474 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include "vec.h"
+#include "../parallel.h"
+#include "../easyRandom.h"
+#include "../benchmark.h"
+
+/*
+Static k-d tree over vec points for nearest neighbour and radius queries.
+
+The tree is balanced (median splits on the axis of largest extent) and stored as a flat array of nodes in depth first
+order, the left child directly follows its parent. Leaves hold buckets of up to leafSize points, which are copied
+into leaf order so a bucket is one contiguous scan. Queries visit the nearer child first and skip cells whose
+distance to the query (tracked incrementally per axis) exceeds the current worst result.
+
+Subtree sizes only depend on the number of points, so all subtrees below the top levels are built in parallel
+into their final place in the arrays.
+
+
+KdTree<DIM, T>(const std::vector<vec<DIM, T>>& points, size_t leafSize = 16, unsigned threads = hardwareThreads())
+KdTree<DIM, T>(const vec<DIM, T>* points, size_t n, size_t leafSize = 16, unsigned threads = hardwareThreads())
+Builds the tree in O(n log n). The points are copied, at most 2^32 - 1.
+
+size_t nearest(const vec<DIM, T>& q, T* sqrDist = nullptr) const
+Index (into the original array) of the point closest to q. The tree must not be empty.
+
+void knn(const vec<DIM, T>& q, size_t k, std::vector<Neighbor>& out) const
+The min(k, size()) nearest points, sorted by distance. Neighbor is {size_t index; T sqrDistance;}.
+
+void radius(const vec<DIM, T>& q, T r, std::vector<Neighbor>& out, bool sorted = false) const
+All points with distance <= r.
+
+std::vector<size_t> nearest(const vec<DIM, T>* queries, size_t n, unsigned threads = hardwareThreads()) const
+std::vector<Neighbor> knn(const vec<DIM, T>* queries, size_t n, size_t k, unsigned threads = hardwareThreads()) const
+Batch queries run in parallel. knn returns k neighbours per query (query i at [i * k, i * k + k>), which requires
+k <= size().
+
+const vec<DIM, T>& point(size_t i) const / size_t size() const
+The original point i and the number of points.
+
+void benchmarkKdTree<DIM = 3, T = float>(size_t n = 1000000, size_t queries = 10000, unsigned threads = 1)
+Builds a tree over n uniformly random points in the unit cube, runs the queries below and a brute force nearest
+scan for queries / 100 of them, and prints the times with BenchTimer.
+
+
+Example:
+
+lameutil::KdTree<3, float> tree(points);
+size_t i = tree.nearest(lameutil::Vec3f(1, 2, 3));
+std::vector<lameutil::KdTree<3, float>::Neighbor> found;
+tree.knn(lameutil::Vec3f(1, 2, 3), 8, found);
+tree.radius(lameutil::Vec3f(1, 2, 3), 0.5f, found);
+
+Timings of benchmarkKdTree(), 10^6 Vec3f, single core, -O2:
+	build                                   ~200 ms
+	nearest, 10^4 queries                   ~7 ms     (brute force (p - q).sqrnorm() scan ~77 ms per 10^2 queries)
+	knn k = 16, 10^4 queries                ~25 ms
+	radius with ~30 results, 10^4 queries   ~16 ms
+*/
+
+namespace lameutil
+{
+	template <size_t DIM, typename T>
+	class KdTree
+	{
+	public:
+		struct Neighbor
+		{
+			size_t index;
+			T sqrDistance;
+
+			bool operator<(const Neighbor& other) const
+			{
+				return sqrDistance < other.sqrDistance;
+			}
+		};
+
+	private:
+		struct Node
+		{
+			T split;
+			uint32_t begin;
+			uint32_t end;
+			//index of the right child, 0 for leaves
+			uint32_t right;
+			uint32_t axis;
+		};
+
+		struct Task
+		{
+			uint32_t node;
+			uint32_t begin;
+			uint32_t end;
+		};
+
+		std::vector<Node> nodes;
+		std::vector<vec<DIM, T>> leafPoints;
+		std::vector<uint32_t> indices;
+		std::vector<vec<DIM, T>> original;
+		size_t leafSize;
+
+	public:
+		KdTree(const std::vector<vec<DIM, T>>& points, size_t leaf = 16, unsigned threads = hardwareThreads()) :
+			KdTree(points.data(), points.size(), leaf, threads)
+		{
+		}
+
+		KdTree(const vec<DIM, T>* points, size_t n, size_t leaf = 16, unsigned threads = hardwareThreads()) :
+			original(points, points + n), leafSize(std::max<size_t>(1, leaf))
+		{
+			assert(n < 0xffffffffULL);
+			indices.resize(n);
+			std::iota(indices.begin(), indices.end(), 0u);
+			nodes.resize(nodeCount(n));
+			if(n == 0)
+			{
+				return;
+			}
+
+			//split serially until there are enough independent subtrees to keep the threads busy
+			std::vector<Task> tasks{Task{0, 0, (uint32_t)n}};
+			const size_t wanted = threads > 1 ? 8 * (size_t)threads : 1;
+			while(tasks.size() < wanted)
+			{
+				std::vector<Task> next;
+				bool split = false;
+				for(const Task& t : tasks)
+				{
+					if(t.end - t.begin <= leafSize)
+					{
+						next.push_back(t);
+						continue;
+					}
+					splitNode(t);
+					next.push_back(Task{t.node + 1, t.begin, mid(t)});
+					next.push_back(Task{nodes[t.node].right, mid(t), t.end});
+					split = true;
+				}
+				tasks.swap(next);
+				if(!split)
+				{
+					break;
+				}
+			}
+			parallelFor(0, tasks.size(), 1, [&](size_t lo, size_t hi)
+			{
+				for(size_t i = lo; i < hi; i++)
+				{
+					build(tasks[i]);
+				}
+			}, threads);
+
+			leafPoints.resize(n);
+			for(size_t i = 0; i < n; i++)
+			{
+				leafPoints[i] = original[indices[i]];
+			}
+		}
+
+		size_t size() const
+		{
+			return original.size();
+		}
+
+		const vec<DIM, T>& point(size_t i) const
+		{
+			assert(i < original.size());
+			return original[i];
+		}
+
+		size_t nearest(const vec<DIM, T>& q, T* sqrDist = nullptr) const
+		{
+			assert(size() > 0);
+			Neighbor best{0, std::numeric_limits<T>::max()};
+			T offset[DIM] = {};
+			searchNearest(0, q, offset, T(), best);
+			if(sqrDist)
+			{
+				*sqrDist = best.sqrDistance;
+			}
+			return best.index;
+		}
+
+		void knn(const vec<DIM, T>& q, size_t k, std::vector<Neighbor>& out) const
+		{
+			out.clear();
+			k = std::min(k, size());
+			if(k == 0)
+			{
+				return;
+			}
+			out.reserve(k);
+			T offset[DIM] = {};
+			searchKnn(0, q, k, offset, T(), out);
+			std::sort_heap(out.begin(), out.end());
+			for(Neighbor& n : out)
+			{
+				n.index = indices[n.index];
+			}
+		}
+
+		void radius(const vec<DIM, T>& q, T r, std::vector<Neighbor>& out, bool sorted = false) const
+		{
+			out.clear();
+			if(size() == 0)
+			{
+				return;
+			}
+			T offset[DIM] = {};
+			searchRadius(0, q, r * r, offset, T(), out);
+			if(sorted)
+			{
+				std::sort(out.begin(), out.end());
+			}
+		}
+
+		std::vector<size_t> nearest(const vec<DIM, T>* queries, size_t n, unsigned threads = hardwareThreads()) const
+		{
+			std::vector<size_t> ret(n);
+			parallelFor(0, n, 256, [&](size_t lo, size_t hi)
+			{
+				for(size_t i = lo; i < hi; i++)
+				{
+					ret[i] = nearest(queries[i]);
+				}
+			}, threads);
+			return ret;
+		}
+
+		std::vector<Neighbor> knn(const vec<DIM, T>* queries, size_t n, size_t k, unsigned threads = hardwareThreads()) const
+		{
+			assert(k <= size());
+			std::vector<Neighbor> ret(n * k);
+			parallelFor(0, n, 64, [&](size_t lo, size_t hi)
+			{
+				std::vector<Neighbor> found;
+				for(size_t i = lo; i < hi; i++)
+				{
+					knn(queries[i], k, found);
+					std::copy(found.begin(), found.end(), ret.begin() + i * k);
+				}
+			}, threads);
+			return ret;
+		}
+
+	private:
+		//number of nodes of the subtree over n points, the left half gets n / 2 points
+		size_t nodeCount(size_t n) const
+		{
+			return n <= leafSize ? 1 : 1 + nodeCount(n / 2) + nodeCount(n - n / 2);
+		}
+
+		static uint32_t mid(const Task& t)
+		{
+			return t.begin + (t.end - t.begin) / 2;
+		}
+
+		//partitions the points of t around the median of the widest axis and fills in the node
+		void splitNode(const Task& t)
+		{
+			vec<DIM, T> lo = original[indices[t.begin]], hi = lo;
+			for(uint32_t i = t.begin + 1; i < t.end; i++)
+			{
+				const vec<DIM, T>& p = original[indices[i]];
+				for(size_t d = 0; d < DIM; d++)
+				{
+					lo[d] = std::min(lo[d], p[d]);
+					hi[d] = std::max(hi[d], p[d]);
+				}
+			}
+			uint32_t axis = 0;
+			for(size_t d = 1; d < DIM; d++)
+			{
+				if(hi[d] - lo[d] > hi[axis] - lo[axis])
+				{
+					axis = (uint32_t)d;
+				}
+			}
+
+			const uint32_t m = mid(t);
+			std::nth_element(indices.begin() + t.begin, indices.begin() + m, indices.begin() + t.end, [&](uint32_t a, uint32_t b)
+			{
+				return original[a][axis] < original[b][axis];
+			});
+
+			Node& node = nodes[t.node];
+			node.begin = t.begin;
+			node.end = t.end;
+			node.axis = axis;
+			node.split = original[indices[m]][axis];
+			node.right = (uint32_t)(t.node + 1 + nodeCount(m - t.begin));
+		}
+
+		void build(const Task& t)
+		{
+			if(t.end - t.begin <= leafSize)
+			{
+				nodes[t.node] = Node{T(), t.begin, t.end, 0, 0};
+				return;
+			}
+			splitNode(t);
+			build(Task{t.node + 1, t.begin, mid(t)});
+			build(Task{nodes[t.node].right, mid(t), t.end});
+		}
+
+		static T sqrDist(const vec<DIM, T>& a, const vec<DIM, T>& b)
+		{
+			T sum = T();
+			for(size_t d = 0; d < DIM; d++)
+			{
+				const T diff = a[d] - b[d];
+				sum += diff * diff;
+			}
+			return sum;
+		}
+
+		//visits the child containing q first, the other one only if the cell can still hold a closer point.
+		//offset[d] is the distance of q to the cell along axis d, cellDist the sum of their squares
+		template <typename Leaf, typename Worst>
+		void search(uint32_t index, const vec<DIM, T>& q, T* offset, T cellDist, Leaf& leaf, Worst& worst) const
+		{
+			const Node& node = nodes[index];
+			if(node.right == 0)
+			{
+				leaf(node);
+				return;
+			}
+			const T diff = q[node.axis] - node.split;
+			const uint32_t nearChild = diff < 0 ? index + 1 : node.right;
+			const uint32_t farChild = diff < 0 ? node.right : index + 1;
+			search(nearChild, q, offset, cellDist, leaf, worst);
+
+			const T old = offset[node.axis];
+			const T farDist = cellDist - old * old + diff * diff;
+			if(farDist <= worst())
+			{
+				offset[node.axis] = diff;
+				search(farChild, q, offset, farDist, leaf, worst);
+				offset[node.axis] = old;
+			}
+		}
+
+		void searchNearest(uint32_t root, const vec<DIM, T>& q, T* offset, T cellDist, Neighbor& best) const
+		{
+			auto leaf = [&](const Node& node)
+			{
+				for(uint32_t i = node.begin; i < node.end; i++)
+				{
+					const T d = sqrDist(leafPoints[i], q);
+					if(d < best.sqrDistance)
+					{
+						best = Neighbor{indices[i], d};
+					}
+				}
+			};
+			auto worst = [&]() { return best.sqrDistance; };
+			search(root, q, offset, cellDist, leaf, worst);
+		}
+
+		//out is a max heap on the distance holding leaf positions until the search is done
+		void searchKnn(uint32_t root, const vec<DIM, T>& q, size_t k, T* offset, T cellDist, std::vector<Neighbor>& out) const
+		{
+			auto leaf = [&](const Node& node)
+			{
+				for(uint32_t i = node.begin; i < node.end; i++)
+				{
+					const T d = sqrDist(leafPoints[i], q);
+					if(out.size() < k)
+					{
+						out.push_back(Neighbor{i, d});
+						std::push_heap(out.begin(), out.end());
+					}
+					else if(d < out.front().sqrDistance)
+					{
+						std::pop_heap(out.begin(), out.end());
+						out.back() = Neighbor{i, d};
+						std::push_heap(out.begin(), out.end());
+					}
+				}
+			};
+			auto worst = [&]() { return out.size() < k ? std::numeric_limits<T>::max() : out.front().sqrDistance; };
+			search(root, q, offset, cellDist, leaf, worst);
+		}
+
+		void searchRadius(uint32_t root, const vec<DIM, T>& q, T r2, T* offset, T cellDist, std::vector<Neighbor>& out) const
+		{
+			auto leaf = [&](const Node& node)
+			{
+				for(uint32_t i = node.begin; i < node.end; i++)
+				{
+					const T d = sqrDist(leafPoints[i], q);
+					if(d <= r2)
+					{
+						out.push_back(Neighbor{indices[i], d});
+					}
+				}
+			};
+			auto worst = [&]() { return r2; };
+			search(root, q, offset, cellDist, leaf, worst);
+		}
+	};
+
+	template <size_t DIM = 3, typename T = float>
+	void benchmarkKdTree(size_t n = 1000000, size_t queries = 10000, unsigned threads = 1)
+	{
+		EasyRandom rg;
+		std::vector<vec<DIM, T>> points(n), q(queries);
+		for(vec<DIM, T>& p : points)
+			for(size_t c = 0; c < DIM; c++)
+				p[c] = (T)rg.getDouble();
+		for(vec<DIM, T>& p : q)
+			for(size_t c = 0; c < DIM; c++)
+				p[c] = (T)rg.getDouble();
+
+		//a ball with ~30 points on average
+		const double volume = 30.0 / (n ? n : 1);
+		const T r = (T)std::pow(volume * 3 / (4 * 3.14159265358979), 1.0 / 3);
+
+		size_t checksum = 0;
+		const KdTree<DIM, T> tree = [&]()
+		{
+			BenchTimer timer("KdTree build, " + std::to_string(n) + " points");
+			return KdTree<DIM, T>(points, 16, threads);
+		}();
+		{
+			BenchTimer timer("KdTree nearest, " + std::to_string(queries) + " queries");
+			for(const vec<DIM, T>& p : q)
+				checksum += tree.nearest(p);
+		}
+		{
+			BenchTimer timer("brute force nearest, " + std::to_string(queries / 100) + " queries");
+			for(size_t i = 0; i < queries / 100; i++)
+			{
+				size_t best = 0;
+				T bestDist = std::numeric_limits<T>::max();
+				for(size_t j = 0; j < n; j++)
+				{
+					const T d = (points[j] - q[i]).sqrnorm();
+					if(d < bestDist)
+					{
+						bestDist = d;
+						best = j;
+					}
+				}
+				checksum += best;
+			}
+		}
+		std::vector<typename KdTree<DIM, T>::Neighbor> found;
+		{
+			BenchTimer timer("KdTree knn k = 16, " + std::to_string(queries) + " queries");
+			for(const vec<DIM, T>& p : q)
+			{
+				tree.knn(p, 16, found);
+				checksum += found.size();
+			}
+		}
+		{
+			BenchTimer timer("KdTree radius, " + std::to_string(queries) + " queries");
+			for(const vec<DIM, T>& p : q)
+			{
+				tree.radius(p, r, found);
+				checksum += found.size();
+			}
+		}
+		volatile size_t sink = checksum;
+		(void)sink;
+	}
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include "vec.h"
+#include "vecArray.h"
+#include "mat.h"
+
+/*
+Quaternions for 3D rotations.
+
+quat<T> is w + xi + yj + zk. Rotations are unit quaternions, q * v rotates a vec<3, T> with two cross products
+(15 multiplications instead of building a matrix). Batches are rotated by converting q to a 3 x 3 matrix once and
+running the SIMD transform kernels of mat.h.
+
+
+quat<T>() / quat(T w, T x, T y, T z) / quat(T w, const vec<3, T>& v)
+The identity rotation or the given components.
+
+static quat fromAxisAngle(const vec<3, T>& axis, T angle) / static quat fromMatrix(const mat<3, 3, T>& m)
+static quat fromMatrix(const mat<4, 4, T>& m) / static quat fromTo(const vec<3, T>& from, const vec<3, T>& to)
+Rotation by angle (radians) around a unit axis, the rotation part of a matrix and the shortest rotation of the
+unit vector from onto the unit vector to.
+
+mat<3, 3, T> toMat3() const / mat<4, 4, T> toMat4() const
+Rotation matrices of a unit quaternion.
+
+vec<3, T> rotate(const vec<3, T>& v) const / q * v
+Rotates v by the unit quaternion q.
+
+q * p, q * scalar, q + p, q - p, -q, ==, !=, <<, conjugate(q), inverse(q), dot(q, p), norm(), sqrnorm(), normalize()
+Quaternion algebra, q * p applies p first and then q.
+
+quat<T> nlerp(const quat<T>& a, const quat<T>& b, T t) / quat<T> slerp(const quat<T>& a, const quat<T>& b, T t)
+Interpolation between unit quaternions along the shorter arc. nlerp is cheaper but not constant speed.
+
+void rotate(const quat<T>& q, const vec<3, T>* in, vec<3, T>* out, size_t n)
+void rotate(const quat<T>& q, const VecArray<3, T>& in, VecArray<3, T>& out)
+Rotates a batch, in and out may be the same.
+
+
+Example:
+
+lameutil::Quatf q = lameutil::Quatf::fromAxisAngle(lameutil::Vec3f(0, 0, 1), 3.14159265f / 2);
+lameutil::Vec3f v = q * lameutil::Vec3f(1, 0, 0); //(0, 1, 0)
+lameutil::Quatf half = lameutil::slerp(lameutil::Quatf(), q, 0.5f);
+lameutil::rotate(q, points.data(), points.data(), points.size());
+
+Timings for 10^7 Vec3f, single core, -O2 -mavx2 -mfma:
+	q * v in a loop             ~50 ms
+	rotate(q, array)            ~5.5 ms
+	rotate(q, VecArray)         ~5 ms
+*/
+
+namespace lameutil
+{
+	template <typename T>
+	struct quat
+	{
+		constexpr quat() : w(T(1)), x(), y(), z() {}
+		constexpr quat(T W, T X, T Y, T Z) : w(W), x(X), y(Y), z(Z) {}
+		constexpr quat(T W, const vec<3, T>& v) : w(W), x(v.x), y(v.y), z(v.z) {}
+
+		static quat fromAxisAngle(const vec<3, T>& axis, T angle)
+		{
+			const T s = (T)std::sin(angle / 2);
+			return quat((T)std::cos(angle / 2), axis * s);
+		}
+
+		//Shepperd's method, picks the largest of w, x, y, z to divide by
+		static constexpr quat fromMatrix(const mat<3, 3, T>& m)
+		{
+			const T trace = m(0, 0) + m(1, 1) + m(2, 2);
+			quat q;
+			if(trace > 0)
+			{
+				const T s = (T)detail::sqrt(trace + 1) * 2;
+				q = quat(s / 4, (m(2, 1) - m(1, 2)) / s, (m(0, 2) - m(2, 0)) / s, (m(1, 0) - m(0, 1)) / s);
+			}
+			else if(m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2))
+			{
+				const T s = (T)detail::sqrt(1 + m(0, 0) - m(1, 1) - m(2, 2)) * 2;
+				q = quat((m(2, 1) - m(1, 2)) / s, s / 4, (m(0, 1) + m(1, 0)) / s, (m(0, 2) + m(2, 0)) / s);
+			}
+			else if(m(1, 1) > m(2, 2))
+			{
+				const T s = (T)detail::sqrt(1 + m(1, 1) - m(0, 0) - m(2, 2)) * 2;
+				q = quat((m(0, 2) - m(2, 0)) / s, (m(0, 1) + m(1, 0)) / s, s / 4, (m(1, 2) + m(2, 1)) / s);
+			}
+			else
+			{
+				const T s = (T)detail::sqrt(1 + m(2, 2) - m(0, 0) - m(1, 1)) * 2;
+				q = quat((m(1, 0) - m(0, 1)) / s, (m(0, 2) + m(2, 0)) / s, (m(1, 2) + m(2, 1)) / s, s / 4);
+			}
+			return q.normalize();
+		}
+
+		static constexpr quat fromMatrix(const mat<4, 4, T>& m)
+		{
+			return fromMatrix(mat<3, 3, T>{
+				m(0, 0), m(0, 1), m(0, 2),
+				m(1, 0), m(1, 1), m(1, 2),
+				m(2, 0), m(2, 1), m(2, 2)});
+		}
+
+		static constexpr quat fromTo(const vec<3, T>& from, const vec<3, T>& to)
+		{
+			const T d = from * to;
+			if(d < T(-1) + T(1e-6))
+			{
+				//opposite vectors, rotate by pi around any perpendicular axis
+				vec<3, T> axis = cross(vec<3, T>(1, 0, 0), from);
+				if(axis.sqrnorm() < 1e-12)
+				{
+					axis = cross(vec<3, T>(0, 1, 0), from);
+				}
+				return quat(0, axis.normalize());
+			}
+			return quat(1 + d, cross(from, to)).normalize();
+		}
+
+		constexpr vec<3, T> vector() const
+		{
+			return vec<3, T>(x, y, z);
+		}
+
+		constexpr VecReal<T> sqrnorm() const { typedef VecReal<T> R; return (R)w * (R)w + (R)x * (R)x + (R)y * (R)y + (R)z * (R)z; }
+		constexpr VecReal<T> norm() const { return detail::sqrt(sqrnorm()); }
+		constexpr quat& normalize() { const T s = (T)(1 / norm()); w *= s; x *= s; y *= s; z *= s; return *this; }
+
+		constexpr vec<3, T> rotate(const vec<3, T>& v) const
+		{
+			const vec<3, T> u = vector();
+			const vec<3, T> t = cross(u, v) * T(2);
+			return v + t * w + cross(u, t);
+		}
+
+		constexpr mat<3, 3, T> toMat3() const
+		{
+			const T xx = x * x, yy = y * y, zz = z * z;
+			const T xy = x * y, xz = x * z, yz = y * z;
+			const T wx = w * x, wy = w * y, wz = w * z;
+			return mat<3, 3, T>{
+				1 - 2 * (yy + zz), 2 * (xy - wz), 2 * (xz + wy),
+				2 * (xy + wz), 1 - 2 * (xx + zz), 2 * (yz - wx),
+				2 * (xz - wy), 2 * (yz + wx), 1 - 2 * (xx + yy)};
+		}
+
+		constexpr mat<4, 4, T> toMat4() const
+		{
+			const mat<3, 3, T> r = toMat3();
+			return mat<4, 4, T>{
+				r(0, 0), r(0, 1), r(0, 2), 0,
+				r(1, 0), r(1, 1), r(1, 2), 0,
+				r(2, 0), r(2, 1), r(2, 2), 0,
+				0, 0, 0, 1};
+		}
+
+		T w, x, y, z;
+	};
+
+	typedef quat<double> Quatd;
+	typedef quat<float > Quatf;
+
+	template <typename T>
+	constexpr quat<T> operator*(const quat<T>& a, const quat<T>& b)
+	{
+		return quat<T>(
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+	}
+
+	template <typename T>
+	constexpr vec<3, T> operator*(const quat<T>& q, const vec<3, T>& v)
+	{
+		return q.rotate(v);
+	}
+
+	template <typename T, typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	constexpr quat<T> operator*(const quat<T>& q, const U& s)
+	{
+		return quat<T>(q.w * (T)s, q.x * (T)s, q.y * (T)s, q.z * (T)s);
+	}
+
+	template <typename T, typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	constexpr quat<T> operator*(const U& s, const quat<T>& q)
+	{
+		return q * s;
+	}
+
+	template <typename T>
+	constexpr quat<T> operator+(const quat<T>& a, const quat<T>& b)
+	{
+		return quat<T>(a.w + b.w, a.x + b.x, a.y + b.y, a.z + b.z);
+	}
+
+	template <typename T>
+	constexpr quat<T> operator-(const quat<T>& a, const quat<T>& b)
+	{
+		return quat<T>(a.w - b.w, a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	template <typename T>
+	constexpr quat<T> operator-(const quat<T>& q)
+	{
+		return quat<T>(-q.w, -q.x, -q.y, -q.z);
+	}
+
+	template <typename T>
+	constexpr bool operator==(const quat<T>& a, const quat<T>& b)
+	{
+		return a.w == b.w && a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	template <typename T>
+	constexpr bool operator!=(const quat<T>& a, const quat<T>& b)
+	{
+		return !(a == b);
+	}
+
+	template <typename T>
+	std::ostream& operator<<(std::ostream& out, const quat<T>& q)
+	{
+		return out << q.w << " " << q.x << " " << q.y << " " << q.z << " ";
+	}
+
+	template <typename T>
+	constexpr T dot(const quat<T>& a, const quat<T>& b)
+	{
+		return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	template <typename T>
+	constexpr quat<T> conjugate(const quat<T>& q)
+	{
+		return quat<T>(q.w, -q.x, -q.y, -q.z);
+	}
+
+	template <typename T>
+	constexpr quat<T> inverse(const quat<T>& q)
+	{
+		return conjugate(q) * (T)(1 / q.sqrnorm());
+	}
+
+	template <typename T>
+	constexpr quat<T> nlerp(const quat<T>& a, const quat<T>& b, T t)
+	{
+		const quat<T> c = dot(a, b) < 0 ? -b : b;
+		return (a * (1 - t) + c * t).normalize();
+	}
+
+	template <typename T>
+	quat<T> slerp(const quat<T>& a, const quat<T>& b, T t)
+	{
+		T d = dot(a, b);
+		const quat<T> c = d < 0 ? -b : b;
+		d = d < 0 ? -d : d;
+		if(d > T(0.9995))
+		{
+			//sin(theta) ~ 0, linear interpolation is exact enough and stable
+			return nlerp(a, c, t);
+		}
+		const T theta = (T)std::acos(d);
+		const T s = (T)(1 / std::sin(theta));
+		return a * (T)(std::sin((1 - t) * theta) * s) + c * (T)(std::sin(t * theta) * s);
+	}
+
+	template <typename T>
+	void rotate(const quat<T>& q, const vec<3, T>* in, vec<3, T>* out, size_t n)
+	{
+		detail::Affine3<T>(q.toMat3()).apply(in, out, n, false);
+	}
+
+	template <typename T>
+	void rotate(const quat<T>& q, const VecArray<3, T>& in, VecArray<3, T>& out)
+	{
+		detail::Affine3<T>(q.toMat3()).apply(in, out, false);
+	}
+}
@@ -0,0 +1,319 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "vec.h"
+#include "../parallel.h"
+
+/*
+Uniform grid spatial hash for fixed radius neighbour search, meant to be rebuilt every step of a simulation.
+
+Space is divided into cubic cells of a given size, every cell is hashed into a table of 2^k buckets (k chosen from
+the number of points). build() counting sorts the points by bucket, so the points of a cell are contiguous. Cells are
+hashed in blocks of 4 x 4 x 4 with consecutive buckets inside a block, which keeps most neighbouring cells close in
+memory as well. A query with radius r visits the buckets of all cells overlapping the cube [q - r, q + r], with the
+cell size equal to r these are at most 3^DIM cells, the cell of q and its neighbours. Build and queries are O(n) for
+bounded densities, independent of the extent of the point set (the grid is never allocated).
+
+The parallel build counts and scatters with atomics and then sorts every bucket by point index, so the result is the
+same for any number of threads.
+
+
+SpatialHash<DIM, T>(T cellSize)
+An empty grid, the cell size should be about the search radius.
+
+void build(const vec<DIM, T>* points, size_t n, unsigned threads = hardwareThreads())
+void build(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+Sorts a copy of the points into the grid. Rebuilding reuses the memory of the previous build.
+
+template <typename F> void forEachNeighbor(const vec<DIM, T>& q, T r, F f) const
+Calls f(size_t index, T sqrDistance) for every point with distance <= r, index is the position in the build array.
+
+template <typename F> void forAllNeighbors(T r, F f, unsigned threads = hardwareThreads()) const
+Calls f(size_t i, size_t j, T sqrDistance) for every ordered pair of different points within r. The points are
+processed in cell order in parallel, calls with the same i are made from one thread.
+
+const vec<DIM, T>* sorted() const / const uint32_t* order() const
+The points in cell order and their indices in the build array, eg. for reordering particle state for locality.
+
+size_t size() const / T cellSize() const
+
+
+Example:
+
+lameutil::SpatialHash<3, float> grid(h);
+grid.build(positions);
+grid.forAllNeighbors(h, [&](size_t i, size_t j, float d2)
+{
+	density[i] += kernel(d2, h);
+});
+
+Timings for 10^6 uniformly random Vec3f with ~30 neighbours each, cell size = r, single core, -O2:
+	build                       ~20 ms
+	forAllNeighbors             ~680 ms
+	forEachNeighbor, 10^4 q     ~10 ms
+	KdTree build (for scale)    ~210 ms
+*/
+
+namespace lameutil
+{
+	template <size_t DIM, typename T>
+	class SpatialHash
+	{
+		T size_;
+		T inverseSize;
+		unsigned bits = 0;
+		std::vector<uint32_t> start;
+		std::vector<uint32_t> bucket;
+		std::vector<uint32_t> indices;
+		std::vector<vec<DIM, T>> points;
+
+	public:
+		explicit SpatialHash(T cellSize) : size_(cellSize), inverseSize(1 / cellSize)
+		{
+			assert(cellSize > 0);
+		}
+
+		size_t size() const
+		{
+			return points.size();
+		}
+
+		T cellSize() const
+		{
+			return size_;
+		}
+
+		const vec<DIM, T>* sorted() const
+		{
+			return points.data();
+		}
+
+		const uint32_t* order() const
+		{
+			return indices.data();
+		}
+
+		void build(const std::vector<vec<DIM, T>>& p, unsigned threads = hardwareThreads())
+		{
+			build(p.data(), p.size(), threads);
+		}
+
+		void build(const vec<DIM, T>* p, size_t n, unsigned threads = hardwareThreads())
+		{
+			assert(n < 0xffffffffULL);
+			//about 2 buckets per point keeps collisions of occupied cells rare
+			bits = 1;
+			while(((size_t)1 << bits) < 2 * n)
+			{
+				bits++;
+			}
+			const size_t buckets = (size_t)1 << bits;
+			start.assign(buckets + 1, 0);
+			bucket.resize(n);
+			indices.resize(n);
+			points.resize(n);
+			const size_t grain = 16384;
+
+			if(threads <= 1 || n <= grain)
+			{
+				for(size_t i = 0; i < n; i++)
+				{
+					bucket[i] = hash(cell(p[i]));
+					start[bucket[i] + 1]++;
+				}
+				for(size_t b = 0; b < buckets; b++)
+				{
+					start[b + 1] += start[b];
+				}
+				std::vector<uint32_t> cursor(start.begin(), start.end() - 1);
+				for(size_t i = 0; i < n; i++)
+				{
+					const uint32_t s = cursor[bucket[i]]++;
+					indices[s] = (uint32_t)i;
+					points[s] = p[i];
+				}
+				return;
+			}
+
+			std::unique_ptr<std::atomic<uint32_t>[]> counts(new std::atomic<uint32_t>[buckets]);
+			parallelFor(0, buckets, 1 << 16, [&](size_t lo, size_t hi)
+			{
+				for(size_t b = lo; b < hi; b++)
+				{
+					counts[b].store(0, std::memory_order_relaxed);
+				}
+			}, threads);
+			parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+			{
+				for(size_t i = lo; i < hi; i++)
+				{
+					bucket[i] = hash(cell(p[i]));
+					counts[bucket[i]].fetch_add(1, std::memory_order_relaxed);
+				}
+			}, threads);
+			for(size_t b = 0; b < buckets; b++)
+			{
+				start[b + 1] = start[b] + counts[b].load(std::memory_order_relaxed);
+				counts[b].store(start[b], std::memory_order_relaxed);
+			}
+			parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+			{
+				for(size_t i = lo; i < hi; i++)
+				{
+					indices[counts[bucket[i]].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)i;
+				}
+			}, threads);
+			//the scatter order within a bucket depends on the scheduling, sort it to be deterministic
+			parallelFor(0, buckets, 1 << 14, [&](size_t lo, size_t hi)
+			{
+				for(size_t b = lo; b < hi; b++)
+				{
+					if(start[b + 1] - start[b] > 1)
+					{
+						std::sort(indices.begin() + start[b], indices.begin() + start[b + 1]);
+					}
+				}
+			}, threads);
+			parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+			{
+				for(size_t i = lo; i < hi; i++)
+				{
+					points[i] = p[indices[i]];
+				}
+			}, threads);
+		}
+
+		template <typename F>
+		void forEachNeighbor(const vec<DIM, T>& q, T r, F f) const
+		{
+			visit(q, r, [&](uint32_t s, T d2)
+			{
+				f((size_t)indices[s], d2);
+			});
+		}
+
+		template <typename F>
+		void forAllNeighbors(T r, F f, unsigned threads = hardwareThreads()) const
+		{
+			parallelFor(0, points.size(), 1024, [&](size_t lo, size_t hi)
+			{
+				for(size_t s = lo; s < hi; s++)
+				{
+					const size_t i = indices[s];
+					visit(points[s], r, [&](uint32_t t, T d2)
+					{
+						if(t != s)
+						{
+							f(i, (size_t)indices[t], d2);
+						}
+					});
+				}
+			}, threads);
+		}
+
+	private:
+		typedef vec<DIM, int64_t> Cell;
+
+		Cell cell(const vec<DIM, T>& p) const
+		{
+			Cell c;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				c[d] = (int64_t)std::floor(p[d] * inverseSize);
+			}
+			return c;
+		}
+
+		//blocks of 4^DIM cells (2^DIM above 3D) are hashed as a whole and the cells of a block get consecutive
+		//buckets, so neighbouring cells are mostly close in memory
+		uint32_t hash(const Cell& c) const
+		{
+			static const uint64_t primes[] = {73856093, 19349663, 83492791, 2654435761};
+			const unsigned side = DIM <= 3 ? 2 : 1;
+			uint64_t h = 0, local = 0;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				const int64_t block = c[d] >> side;
+				h ^= (uint64_t)block * primes[d % 4] + (uint64_t)d * 0x9e3779b97f4a7c15ULL;
+				local |= (uint64_t)(c[d] & ((1 << side) - 1)) << (side * d);
+			}
+			h = (h * 0x9e3779b97f4a7c15ULL) >> 32;
+			return (uint32_t)(((h << (side * DIM)) | local) & (((uint64_t)1 << bits) - 1));
+		}
+
+		//calls f(sorted position, squared distance) for the points within r of q. Different cells can share a
+		//bucket, every bucket is scanned once
+		template <typename F>
+		void visit(const vec<DIM, T>& q, T r, F f) const
+		{
+			if(points.empty())
+			{
+				return;
+			}
+			const T r2 = r * r;
+			Cell lo, hi;
+			size_t cells = 1;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				lo[d] = (int64_t)std::floor((q[d] - r) * inverseSize);
+				hi[d] = (int64_t)std::floor((q[d] + r) * inverseSize);
+				cells *= (size_t)(hi[d] - lo[d] + 1);
+			}
+
+			uint32_t local[64];
+			std::vector<uint32_t> many;
+			uint32_t* seen = local;
+			if(cells > 64)
+			{
+				many.resize(cells);
+				seen = many.data();
+			}
+			size_t count = 0;
+			Cell c = lo;
+			for(size_t k = 0; k < cells; k++)
+			{
+				const uint32_t h = hash(c);
+				if(cells > 64 || std::find(seen, seen + count, h) == seen + count)
+				{
+					seen[count++] = h;
+				}
+				for(size_t d = 0; d < DIM; d++)
+				{
+					if(++c[d] <= hi[d])
+					{
+						break;
+					}
+					c[d] = lo[d];
+				}
+			}
+			if(cells > 64)
+			{
+				std::sort(seen, seen + count);
+				count = std::unique(seen, seen + count) - seen;
+			}
+
+			for(size_t k = 0; k < count; k++)
+			{
+				for(uint32_t s = start[seen[k]]; s < start[seen[k] + 1]; s++)
+				{
+					T d2 = T();
+					for(size_t d = 0; d < DIM; d++)
+					{
+						const T diff = points[s][d] - q[d];
+						d2 += diff * diff;
+					}
+					if(d2 <= r2)
+					{
+						f(s, d2);
+					}
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,410 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "vec.h"
+#include "../parallel.h"
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+/*
+Morton (Z-order) and Hilbert keys for 2D and 3D points and a parallel radix sort, to put point sets into an order
+where points close in space are close in memory. Kernels working on neighbours (k-d tree and grid queries, particle
+interactions, mesh processing) then stream through memory instead of missing the cache on every point.
+
+Morton keys interleave the coordinate bits, with BMI2 (-mbmi2 / AVX2 targets) this is one pdep per axis, otherwise
+bytes are spread with lookup tables. Hilbert keys map the coordinates with Skilling's transform first (branch free
+and 8 points at a time in spatialKeys), the curve has no jumps, which gives somewhat better locality for the price of
+a slower encoding.
+
+The radix sort is a stable LSD sort of 64 bit keys with 11 bit digits, digits that are equal for all keys are skipped.
+Every pass counts and scatters chunks of the array in parallel. The result does not depend on the number of threads.
+
+
+uint64_t mortonEncode(uint32_t x, uint32_t y) / uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z)
+void mortonDecode(uint64_t key, uint32_t& x, uint32_t& y) / void mortonDecode(uint64_t key, uint32_t& x, uint32_t& y, uint32_t& z)
+uint64_t hilbertEncode(uint32_t x, uint32_t y) / uint64_t hilbertEncode(uint32_t x, uint32_t y, uint32_t z)
+Keys of integer coordinates, 32 bits per axis in 2D and 21 bits in 3D (higher bits are ignored).
+
+std::vector<uint64_t> spatialKeys(const vec<DIM, T>* points, size_t n, SpaceCurve curve, unsigned threads = hardwareThreads())
+Keys of points (DIM 2 or 3) quantized on a grid over their bounding cube. SpaceCurve is Morton or Hilbert.
+
+std::vector<uint32_t> sortedOrder(const uint64_t* keys, size_t n, unsigned threads = hardwareThreads())
+The permutation that stably sorts the keys, order[i] is the index of the i-th smallest key.
+
+void permute(std::vector<V>& v, const std::vector<uint32_t>& order, unsigned threads = hardwareThreads())
+Reorders v to v[order[0]], v[order[1]], ...
+
+std::vector<uint32_t> spatialSort(SpaceCurve curve, std::vector<vec<DIM, T>>& points, std::vector<P>&... payloads)
+Sorts points along the curve and applies the same order to any number of payload vectors of the same length.
+Returns the order, order[i] is the former index of the point now at i.
+
+
+Example:
+
+std::vector<lameutil::Vec3f> positions;
+std::vector<lameutil::Vec3f> velocities;
+std::vector<float> mass;
+lameutil::spatialSort(lameutil::SpaceCurve::Hilbert, positions, velocities, mass);
+
+Timings for 10^7 uniformly random Vec3f, single core, -O2 -mavx2 -mbmi2:
+	spatialKeys Morton                 ~70 ms (~80 ms with lookup tables)
+	spatialKeys Hilbert                ~600 ms
+	sortedOrder                        ~330 ms (std::sort of key/index pairs ~700 ms)
+	spatialSort Hilbert, 2 payloads    ~1200 ms
+	10^6 KdTree nearest queries in random / Hilbert order of the queries    ~650 ms / ~210 ms
+*/
+
+namespace lameutil
+{
+	enum class SpaceCurve
+	{
+		Morton,
+		Hilbert
+	};
+
+	namespace detail
+	{
+		//the 8 bits of a byte spread out to every 2nd / 3rd bit
+		struct MortonTables
+		{
+			uint32_t spread2[256];
+			uint32_t spread3[256];
+
+			constexpr MortonTables() : spread2(), spread3()
+			{
+				for(uint32_t b = 0; b < 256; b++)
+				{
+					for(uint32_t i = 0; i < 8; i++)
+					{
+						spread2[b] |= (b >> i & 1) << (2 * i);
+						spread3[b] |= (b >> i & 1) << (3 * i);
+					}
+				}
+			}
+		};
+
+		inline constexpr MortonTables mortonTables{};
+
+		inline uint64_t spread2(uint32_t x)
+		{
+#if defined(__BMI2__)
+			return _pdep_u64(x, 0x5555555555555555ULL);
+#else
+			const uint32_t* t = mortonTables.spread2;
+			return (uint64_t)t[x & 0xff] | (uint64_t)t[x >> 8 & 0xff] << 16 | (uint64_t)t[x >> 16 & 0xff] << 32 | (uint64_t)t[x >> 24] << 48;
+#endif
+		}
+
+		inline uint64_t spread3(uint32_t x)
+		{
+#if defined(__BMI2__)
+			return _pdep_u64(x, 0x1249249249249249ULL);
+#else
+			const uint32_t* t = mortonTables.spread3;
+			return (uint64_t)t[x & 0xff] | (uint64_t)t[x >> 8 & 0xff] << 24 | (uint64_t)t[x >> 16 & 0x1f] << 48;
+#endif
+		}
+
+		inline uint32_t compact2(uint64_t x)
+		{
+#if defined(__BMI2__)
+			return (uint32_t)_pext_u64(x, 0x5555555555555555ULL);
+#else
+			x &= 0x5555555555555555ULL;
+			x = (x | x >> 1) & 0x3333333333333333ULL;
+			x = (x | x >> 2) & 0x0f0f0f0f0f0f0f0fULL;
+			x = (x | x >> 4) & 0x00ff00ff00ff00ffULL;
+			x = (x | x >> 8) & 0x0000ffff0000ffffULL;
+			return (uint32_t)(x | x >> 16);
+#endif
+		}
+
+		inline uint32_t compact3(uint64_t x)
+		{
+#if defined(__BMI2__)
+			return (uint32_t)_pext_u64(x, 0x1249249249249249ULL);
+#else
+			x &= 0x1249249249249249ULL;
+			x = (x | x >> 2) & 0x10c30c30c30c30c3ULL;
+			x = (x | x >> 4) & 0x100f00f00f00f00fULL;
+			x = (x | x >> 8) & 0x001f0000ff0000ffULL;
+			x = (x | x >> 16) & 0x001f00000000ffffULL;
+			return (uint32_t)((x | x >> 32) & 0x1fffff);
+#endif
+		}
+
+		//Skilling, "Programming the Hilbert curve" (2004). Turns the coordinates into the transposed Hilbert index,
+		//bit k of the index is spread over bit k / DIM of the coordinates. Transforms W points at once, x[axis][lane],
+		//the lane loops are innermost so they compile to SIMD
+		template <size_t DIM, size_t W>
+		void hilbertTranspose(uint32_t (&x)[DIM][W], unsigned bits)
+		{
+			//branch free, the branches on coordinate bits are unpredictable: if bit k of x[i] is set x[0] gets its
+			//lower bits inverted, otherwise the lower bits of x[0] and x[i] are exchanged
+			for(unsigned k = bits - 1; k > 0; k--)
+			{
+				const uint32_t p = (1u << k) - 1;
+				for(size_t i = 0; i < DIM; i++)
+				{
+					for(size_t w = 0; w < W; w++)
+					{
+						const uint32_t set = 0u - (x[i][w] >> k & 1);
+						const uint32_t t = (x[0][w] ^ x[i][w]) & p & ~set;
+						x[0][w] ^= (p & set) | t;
+						x[i][w] ^= t;
+					}
+				}
+			}
+			for(size_t i = 1; i < DIM; i++)
+			{
+				for(size_t w = 0; w < W; w++)
+				{
+					x[i][w] ^= x[i - 1][w];
+				}
+			}
+			uint32_t t[W] = {};
+			for(unsigned k = bits - 1; k > 0; k--)
+			{
+				for(size_t w = 0; w < W; w++)
+				{
+					t[w] ^= ((1u << k) - 1) & (0u - (x[DIM - 1][w] >> k & 1));
+				}
+			}
+			for(size_t i = 0; i < DIM; i++)
+			{
+				for(size_t w = 0; w < W; w++)
+				{
+					x[i][w] ^= t[w];
+				}
+			}
+		}
+	}
+
+	inline uint64_t mortonEncode(uint32_t x, uint32_t y)
+	{
+		return detail::spread2(x) | detail::spread2(y) << 1;
+	}
+
+	inline uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return detail::spread3(x & 0x1fffff) | detail::spread3(y & 0x1fffff) << 1 | detail::spread3(z & 0x1fffff) << 2;
+	}
+
+	inline void mortonDecode(uint64_t key, uint32_t& x, uint32_t& y)
+	{
+		x = detail::compact2(key);
+		y = detail::compact2(key >> 1);
+	}
+
+	inline void mortonDecode(uint64_t key, uint32_t& x, uint32_t& y, uint32_t& z)
+	{
+		x = detail::compact3(key);
+		y = detail::compact3(key >> 1);
+		z = detail::compact3(key >> 2);
+	}
+
+	inline uint64_t hilbertEncode(uint32_t x, uint32_t y)
+	{
+		uint32_t t[2][1] = {{x}, {y}};
+		detail::hilbertTranspose(t, 32);
+		return mortonEncode(t[1][0], t[0][0]);
+	}
+
+	inline uint64_t hilbertEncode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		uint32_t t[3][1] = {{x & 0x1fffff}, {y & 0x1fffff}, {z & 0x1fffff}};
+		detail::hilbertTranspose(t, 21);
+		return mortonEncode(t[2][0], t[1][0], t[0][0]);
+	}
+
+	template <size_t DIM, typename T>
+	std::vector<uint64_t> spatialKeys(const vec<DIM, T>* points, size_t n, SpaceCurve curve, unsigned threads = hardwareThreads())
+	{
+		static_assert(DIM == 2 || DIM == 3, "Space filling curve keys are implemented for 2D and 3D points.");
+		std::vector<uint64_t> keys(n);
+		if(n == 0)
+		{
+			return keys;
+		}
+
+		const size_t grain = 1 << 16;
+		std::vector<vec<DIM, T>> lows(chunkCount(0, n, grain), points[0]), highs(lows);
+		parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+		{
+			vec<DIM, T>& l = lows[lo / grain];
+			vec<DIM, T>& h = highs[lo / grain];
+			for(size_t i = lo; i < hi; i++)
+			{
+				for(size_t d = 0; d < DIM; d++)
+				{
+					l[d] = std::min(l[d], points[i][d]);
+					h[d] = std::max(h[d], points[i][d]);
+				}
+			}
+		}, threads);
+		vec<DIM, T> low = lows[0], high = highs[0];
+		for(size_t c = 1; c < lows.size(); c++)
+		{
+			for(size_t d = 0; d < DIM; d++)
+			{
+				low[d] = std::min(low[d], lows[c][d]);
+				high[d] = std::max(high[d], highs[c][d]);
+			}
+		}
+
+		//a cube keeps the cells of the curve square
+		double extent = 0;
+		for(size_t d = 0; d < DIM; d++)
+		{
+			extent = std::max(extent, (double)high[d] - (double)low[d]);
+		}
+		const unsigned bits = DIM == 2 ? 32 : 21;
+		const double cells = (double)((1ULL << bits) - 1);
+		const double scale = extent > 0 ? cells / extent : 0;
+
+		//blocks of 8 points, so the Hilbert transform runs on all 8 at once
+		const size_t W = 8;
+		parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+		{
+			for(size_t i = lo; i < hi; i += W)
+			{
+				const size_t lanes = std::min(W, hi - i);
+				uint32_t c[DIM][W] = {};
+				for(size_t w = 0; w < lanes; w++)
+				{
+					for(size_t d = 0; d < DIM; d++)
+					{
+						c[d][w] = (uint32_t)std::min(cells, ((double)points[i + w][d] - (double)low[d]) * scale);
+					}
+				}
+				if(curve == SpaceCurve::Hilbert)
+				{
+					detail::hilbertTranspose(c, bits);
+					for(size_t w = 0; w < lanes; w++)
+					{
+						if constexpr(DIM == 2)
+						{
+							keys[i + w] = mortonEncode(c[1][w], c[0][w]);
+						}
+						else
+						{
+							keys[i + w] = mortonEncode(c[2][w], c[1][w], c[0][w]);
+						}
+					}
+					continue;
+				}
+				for(size_t w = 0; w < lanes; w++)
+				{
+					if constexpr(DIM == 2)
+					{
+						keys[i + w] = mortonEncode(c[0][w], c[1][w]);
+					}
+					else
+					{
+						keys[i + w] = mortonEncode(c[0][w], c[1][w], c[2][w]);
+					}
+				}
+			}
+		}, threads);
+		return keys;
+	}
+
+	inline std::vector<uint32_t> sortedOrder(const uint64_t* keys, size_t n, unsigned threads = hardwareThreads())
+	{
+		assert(n < 0xffffffffULL);
+		const unsigned digitBits = 11;
+		const size_t radix = (size_t)1 << digitBits;
+		const size_t grain = std::max<size_t>(1 << 16, n / (4 * (size_t)std::max(1u, threads)) + 1);
+		const size_t chunks = chunkCount(0, n, grain);
+
+		std::vector<uint32_t> order(n), orderTmp(n);
+		std::vector<uint64_t> sorted(keys, keys + n), sortedTmp(n);
+		for(size_t i = 0; i < n; i++)
+		{
+			order[i] = (uint32_t)i;
+		}
+		if(n < 2)
+		{
+			return order;
+		}
+
+		//bits that differ between keys, passes over digits without any are skipped
+		uint64_t differ = 0;
+		for(size_t i = 1; i < n; i++)
+		{
+			differ |= keys[i] ^ keys[0];
+		}
+
+		//offsets of every digit in every chunk, digit major so the scatter stays stable
+		std::vector<uint32_t> offsets(chunks * radix);
+		for(unsigned shift = 0; shift < 64; shift += digitBits)
+		{
+			if(!(differ >> shift & (radix - 1)))
+			{
+				continue;
+			}
+			parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+			{
+				uint32_t* count = offsets.data() + lo / grain * radix;
+				std::fill(count, count + radix, 0u);
+				for(size_t i = lo; i < hi; i++)
+				{
+					count[sorted[i] >> shift & (radix - 1)]++;
+				}
+			}, threads);
+			uint32_t sum = 0;
+			for(size_t digit = 0; digit < radix; digit++)
+			{
+				for(size_t c = 0; c < chunks; c++)
+				{
+					const uint32_t count = offsets[c * radix + digit];
+					offsets[c * radix + digit] = sum;
+					sum += count;
+				}
+			}
+			parallelFor(0, n, grain, [&](size_t lo, size_t hi)
+			{
+				uint32_t* offset = offsets.data() + lo / grain * radix;
+				for(size_t i = lo; i < hi; i++)
+				{
+					const uint32_t dst = offset[sorted[i] >> shift & (radix - 1)]++;
+					sortedTmp[dst] = sorted[i];
+					orderTmp[dst] = order[i];
+				}
+			}, threads);
+			sorted.swap(sortedTmp);
+			order.swap(orderTmp);
+		}
+		return order;
+	}
+
+	template <typename V>
+	void permute(std::vector<V>& v, const std::vector<uint32_t>& order, unsigned threads = hardwareThreads())
+	{
+		assert(v.size() == order.size());
+		std::vector<V> ret(v.size());
+		parallelFor(0, v.size(), 1 << 16, [&](size_t lo, size_t hi)
+		{
+			for(size_t i = lo; i < hi; i++)
+			{
+				ret[i] = v[order[i]];
+			}
+		}, threads);
+		v.swap(ret);
+	}
+
+	template <size_t DIM, typename T, typename... P>
+	std::vector<uint32_t> spatialSort(SpaceCurve curve, std::vector<vec<DIM, T>>& points, std::vector<P>&... payloads)
+	{
+		const std::vector<uint64_t> keys = spatialKeys(points.data(), points.size(), curve);
+		std::vector<uint32_t> order = sortedOrder(keys.data(), keys.size());
+		permute(points, order);
+		(permute(payloads, order), ...);
+		return order;
+	}
+}
@@ -4,41 +4,144 @@
 #include <cassert>
 #include <iostream>
 #include <utility>
+#include <type_traits>
+#include <limits>
+#include <initializer_list>
 //#define LAME_VEC_DISABLE_ANON_STRUCT 1
 
+//true while a constexpr function is being evaluated at compile time, used to switch from std::sqrt and the SIMD
+//intrinsics to plain C++. Without compiler support the SIMD specializations are not constexpr.
+#if defined(__cpp_lib_is_constant_evaluated)
+#define LAME_VEC_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif (defined(__GNUC__) && __GNUC__ >= 9) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#define LAME_VEC_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#elif defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define LAME_VEC_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+
+#ifdef LAME_VEC_CONSTANT_EVALUATED
+#define LAME_VEC_SIMD_CONSTEXPR constexpr
+#else
+#define LAME_VEC_CONSTANT_EVALUATED() false
+#define LAME_VEC_SIMD_CONSTEXPR
+#endif
+
 namespace lameutil
 {
+	namespace detail
+	{
+		//r * r - x without rounding error in the product (Dekker), for r * r and x within a factor of 2
+		constexpr double sqrtResidual(double r, double x)
+		{
+			const double split = 134217729.0 * r;
+			const double hi = split - (split - r);
+			const double lo = r - hi;
+			const double p = r * r;
+			const double err = ((hi * hi - p) + 2 * hi * lo) + lo * lo;
+			return (p - x) + err;
+		}
+
+		//correctly rounded square root for constant expressions (at run time sqrt() uses std::sqrt). x is scaled into [1, 4> by powers of 4,
+		//Newton's method gets within an ulp and the neighbour with the smallest residual is the rounded result
+		constexpr double constexprSqrt(double x)
+		{
+			if(!(x > 0) || x == x + x)
+			{
+				return x < 0 ? std::numeric_limits<double>::quiet_NaN() : x;
+			}
+			double scale = 1;
+			for(; x >= 4; x *= 0.25, scale *= 2);
+			for(; x < 1; x *= 4, scale *= 0.5);
+
+			double r = 1.5;
+			for(int i = 0; i < 6; i++)
+			{
+				r = 0.5 * (r + x / r);
+			}
+			const double ulp = std::numeric_limits<double>::epsilon();
+			double best = r;
+			double bestError = sqrtResidual(r, x);
+			bestError = bestError < 0 ? -bestError : bestError;
+			for(double candidate : {r - ulp, r + ulp})
+			{
+				double error = sqrtResidual(candidate, x);
+				error = error < 0 ? -error : error;
+				if(error < bestError)
+				{
+					best = candidate;
+					bestError = error;
+				}
+			}
+			return best * scale;
+		}
+
+		constexpr double sqrt(double x)
+		{
+			return LAME_VEC_CONSTANT_EVALUATED() ? constexprSqrt(x) : std::sqrt(x);
+		}
+
+		//the correctly rounded double root rounds to the correctly rounded float root
+		constexpr float sqrt(float x)
+		{
+			return LAME_VEC_CONSTANT_EVALUATED() ? (float)constexprSqrt(x) : std::sqrt(x);
+		}
+
+		constexpr long double sqrt(long double x)
+		{
+			return LAME_VEC_CONSTANT_EVALUATED() ? constexprSqrt((double)x) : std::sqrt(x);
+		}
+	}
+
+	//the type sqrnorm(), norm(), sqrdistance() and distance() compute in and return for vec<DIM, T>. Floating point
+	//vectors stay in their precision, integer components are converted to double before they are squared, so the
+	//sum cannot overflow. Specialize it for other component types, eg. to return double for float vectors:
+	//template <> struct lameutil::VecPrecision<float> { typedef double type; };
+	//Defining LAME_VEC_DOUBLE_NORMS before including vec.h returns double for every T, like older versions.
+	template <typename T, typename = void>
+	struct VecPrecision
+	{
+		typedef double type;
+	};
+
+#if !defined(LAME_VEC_DOUBLE_NORMS)
+	template <typename T>
+	struct VecPrecision<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+	{
+		typedef T type;
+	};
+#endif
+
+	template <typename T>
+	using VecReal = typename VecPrecision<T>::type;
+
 	template <size_t DIM, typename T>
 	struct vec
 	{
-		vec()
+		constexpr vec() : m_data{}
 		{
-			for (size_t i = DIM; i--; m_data[i] = T());
 		}
-		vec(const std::initializer_list<T>& l)
+		constexpr vec(const std::initializer_list<T>& l) : m_data{}
 		{
 			assert(l.size() <= DIM);
 			size_t j = 0;
 			for (auto i = l.begin(); i != l.end(); m_data[j++] = *(i++));
-			for (j; j < DIM; j++)
-			{
-				m_data[j] = T();
-			}
 		}
-		T& operator[](const size_t i) { assert(i < DIM); return m_data[i]; }
-		const T& operator[](const size_t i) const { assert(i < DIM); return m_data[i]; }
+		constexpr T& operator[](const size_t i) { assert(i < DIM); return m_data[i]; }
+		constexpr const T& operator[](const size_t i) const { assert(i < DIM); return m_data[i]; }
 
-		double sqrnorm() const
+		constexpr VecReal<T> sqrnorm() const
 		{
-			T sum = T();
-			for (size_t i = DIM; i--; sum += m_data[i] * m_data[i]);
+			VecReal<T> sum = VecReal<T>();
+			for (size_t i = DIM; i--; sum += (VecReal<T>)m_data[i] * (VecReal<T>)m_data[i]);
 			return sum;
 		}
-		double norm() const
+		constexpr VecReal<T> norm() const
 		{
-			return std::sqrt(sqrnorm());
+			return detail::sqrt(sqrnorm());
 		}
-		inline vec<DIM, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
+		constexpr inline vec<DIM, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
 	private:
 		T m_data[DIM];
 	};
@@ -56,13 +159,13 @@ namespace lameutil
 	template <typename T>
 	struct vec<2, T>
 	{
-		vec() : x(T()), y(T()) {}
-		vec(T X, T Y) : x(X), y(Y) {}
-		T& operator[](const size_t i) { assert(i < 2); return i <= 0 ? x : y; }
-		const T& operator[](const size_t i) const { assert(i < 2); return i <= 0 ? x : y; }
-		double norm() const { return std::sqrt(sqrnorm()); }
-		inline double sqrnorm() const { return x * x + y * y; }
-		inline vec<2, T>& normalize() { *this = (*this) * (1 / norm()); return *this;}
+		constexpr vec() : x(T()), y(T()) {}
+		constexpr vec(T X, T Y) : x(X), y(Y) {}
+		constexpr T& operator[](const size_t i) { assert(i < 2); return i <= 0 ? x : y; }
+		constexpr const T& operator[](const size_t i) const { assert(i < 2); return i <= 0 ? x : y; }
+		constexpr VecReal<T> norm() const { return detail::sqrt(sqrnorm()); }
+		constexpr inline VecReal<T> sqrnorm() const { typedef VecReal<T> R; return (R)x * (R)x + (R)y * (R)y; }
+		constexpr inline vec<2, T>& normalize() { *this = (*this) * (1 / norm()); return *this;}
 
 #if LAME_VEC_DISABLE_ANON_STRUCT
 		T x, y;
@@ -79,13 +182,13 @@ namespace lameutil
 	template <typename T>
 	struct vec<3, T>
 	{
-		vec() : x(T()), y(T()), z(T()) {}
-		vec(T X, T Y, T Z) : x(X), y(Y), z(Z) {}
-		T& operator[](const size_t i) { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
-		const T& operator[](const size_t i) const { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
-		inline double norm() const {return std::sqrt(sqrnorm());}
-		inline double sqrnorm() const { return x * x + y * y + z * z; }
-		inline vec<3, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
+		constexpr vec() : x(T()), y(T()), z(T()) {}
+		constexpr vec(T X, T Y, T Z) : x(X), y(Y), z(Z) {}
+		constexpr T& operator[](const size_t i) { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
+		constexpr const T& operator[](const size_t i) const { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
+		constexpr inline VecReal<T> norm() const {return detail::sqrt(sqrnorm());}
+		constexpr inline VecReal<T> sqrnorm() const { typedef VecReal<T> R; return (R)x * (R)x + (R)y * (R)y + (R)z * (R)z; }
+		constexpr inline vec<3, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
 #if LAME_VEC_DISABLE_ANON_STRUCT
 		T x, y, z;
 #else
@@ -101,13 +204,13 @@ namespace lameutil
 	template <typename T>
 	struct vec<4, T>
 	{
-		vec() : x(T()), y(T()), z(T()), w(T()) {}
-		vec(T X, T Y, T Z, T W) : x(X), y(Y), z(Z), w(W) {}
-		T& operator[](const size_t i) { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
-		const T& operator[](const size_t i) const { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
-		double norm() const { return std::sqrt(sqrnorm()); }
-		inline double sqrnorm() const { return x * x + y * y + z * z + w*w; }
-		inline vec<4, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
+		constexpr vec() : x(T()), y(T()), z(T()), w(T()) {}
+		constexpr vec(T X, T Y, T Z, T W) : x(X), y(Y), z(Z), w(W) {}
+		constexpr T& operator[](const size_t i) { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr const T& operator[](const size_t i) const { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr VecReal<T> norm() const { return detail::sqrt(sqrnorm()); }
+		constexpr inline VecReal<T> sqrnorm() const { typedef VecReal<T> R; return (R)x * (R)x + (R)y * (R)y + (R)z * (R)z + (R)w * (R)w; }
+		constexpr inline vec<4, T>& normalize() { *this = (*this) * (1 / norm()); return *this; }
 #if LAME_VEC_DISABLE_ANON_STRUCT
 		T x, y, z, w;
 #else
@@ -121,7 +224,7 @@ namespace lameutil
 	};
 
 	template<size_t DIM, typename T>
-	T operator*(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	constexpr T operator*(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
 	{
 		T ret = T();
 		for (size_t i = DIM; i--; ret += lhs[i] * rhs[i]);
@@ -129,35 +232,35 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T>
-	vec<DIM, T> operator+(vec<DIM, T> lhs, const vec<DIM, T>& rhs)
+	constexpr vec<DIM, T> operator+(vec<DIM, T> lhs, const vec<DIM, T>& rhs)
 	{
 		for (size_t i = DIM; i--; lhs[i] += rhs[i]);
 		return lhs;
 	}
 
 	template<size_t DIM, typename T>
-	vec<DIM, T>& operator+=(vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	constexpr vec<DIM, T>& operator+=(vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
 	{
 		for (size_t i = DIM; i--; lhs[i] += rhs[i]);
 		return lhs;
 	}
 
 	template<size_t DIM, typename T>
-	vec<DIM, T> operator-(vec<DIM, T> lhs, const vec<DIM, T>& rhs)
+	constexpr vec<DIM, T> operator-(vec<DIM, T> lhs, const vec<DIM, T>& rhs)
 	{
 		for (size_t i = DIM; i--; lhs[i] -= rhs[i]);
 		return lhs;
 	}
 
 	template<size_t DIM, typename T>
-	vec<DIM, T>& operator-=(vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	constexpr vec<DIM, T>& operator-=(vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
 	{
 		for (size_t i = DIM; i--; lhs[i] -= rhs[i]);
 		return lhs;
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator*(const vec<DIM, T>& v, const U& scalar)
+	constexpr vec<DIM, T> operator*(const vec<DIM, T>& v, const U& scalar)
 	{
 		vec<DIM, T> ret;
 		for (size_t i = DIM; i--; ret[i] = v[i] * (T)scalar);
@@ -165,7 +268,7 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator*(const U& scalar, const vec<DIM, T>& v)
+	constexpr vec<DIM, T> operator*(const U& scalar, const vec<DIM, T>& v)
 	{
 		vec<DIM, T> ret;
 		for (size_t i = DIM; i--; ret[i] = v[i] * (T)scalar);
@@ -173,14 +276,14 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator*=(vec<DIM, T>& v, const U& scalar)
+	constexpr vec<DIM, T> operator*=(vec<DIM, T>& v, const U& scalar)
 	{
 		for (size_t i = DIM; i--; v[i] *= scalar);
 		return v;
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator/(const vec<DIM, T>& v, const U& scalar)
+	constexpr vec<DIM, T> operator/(const vec<DIM, T>& v, const U& scalar)
 	{
 		vec<DIM, T> ret;
 		for (size_t i = DIM; i--; ret[i] = v[i] / scalar);
@@ -188,7 +291,7 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator/(const U& scalar, const vec<DIM, T>& v)
+	constexpr vec<DIM, T> operator/(const U& scalar, const vec<DIM, T>& v)
 	{
 		vec<DIM, T> ret;
 		for (size_t i = DIM; i--; ret[i] = v[i] / scalar);
@@ -196,20 +299,20 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T, typename U>
-	vec<DIM, T> operator/=(vec<DIM, T>& v, const U& scalar)
+	constexpr vec<DIM, T> operator/=(vec<DIM, T>& v, const U& scalar)
 	{
 		for (size_t i = DIM; i--; v[i] /= scalar);
 		return v;
 	}
 
 	template<size_t DIM, typename T>
-	vec<DIM, T> operator-(const vec<DIM, T>& v)
+	constexpr vec<DIM, T> operator-(const vec<DIM, T>& v)
 	{
 		return v * T(-1);
 	}
 
 	template <size_t DIM, typename T>
-	bool operator==(const vec<DIM, T>& v, const vec<DIM, T>& u)
+	constexpr bool operator==(const vec<DIM, T>& v, const vec<DIM, T>& u)
 	{
 	    bool ret = true;
 	    for (size_t i = DIM; i--; ret &= (v[i] == u[i]));
@@ -217,13 +320,53 @@ namespace lameutil
 	}
 
 	template <size_t DIM, typename T>
-	bool operator!=(const vec<DIM, T>& v, const vec<DIM, T>& u)
+	constexpr bool operator!=(const vec<DIM, T>& v, const vec<DIM, T>& u)
 	{
 	    return !(v==u);
 	}
 
+	template<size_t DIM, typename T>
+	constexpr T dot(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	{
+		return lhs * rhs;
+	}
+
+	template<size_t DIM, typename T>
+	constexpr vec<DIM, T> vmin(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	{
+		vec<DIM, T> ret;
+		for (size_t i = DIM; i--; ret[i] = rhs[i] < lhs[i] ? rhs[i] : lhs[i]);
+		return ret;
+	}
+
+	template<size_t DIM, typename T>
+	constexpr vec<DIM, T> vmax(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	{
+		vec<DIM, T> ret;
+		for (size_t i = DIM; i--; ret[i] = lhs[i] < rhs[i] ? rhs[i] : lhs[i]);
+		return ret;
+	}
+
+	//a * b + c, component-wise
+	template<size_t DIM, typename T>
+	constexpr vec<DIM, T> fmadd(const vec<DIM, T>& a, const vec<DIM, T>& b, const vec<DIM, T>& c)
+	{
+		vec<DIM, T> ret;
+		for (size_t i = DIM; i--; ret[i] = a[i] * b[i] + c[i]);
+		return ret;
+	}
+
+	//a * s + c
+	template<size_t DIM, typename T>
+	constexpr vec<DIM, T> fmadd(const vec<DIM, T>& a, const T& s, const vec<DIM, T>& c)
+	{
+		vec<DIM, T> ret;
+		for (size_t i = DIM; i--; ret[i] = a[i] * s + c[i]);
+		return ret;
+	}
+
 	template <typename T> 
-	vec<3, T> cross(const vec<3, T>& v1, const vec<3, T>& v2)
+	constexpr vec<3, T> cross(const vec<3, T>& v1, const vec<3, T>& v2)
 	{
 		return vec<3, T>(v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x);
 	}
@@ -236,23 +379,68 @@ namespace lameutil
 	}
 
 	template<size_t DIM, typename T>
-	double sqrdistance(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	constexpr VecReal<T> sqrdistance(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
 	{
-		double sum = 0;
-		for (size_t i = DIM; i--; sum += (double)(lhs[i] - rhs[i]) * (lhs[i] - rhs[i]));
+		VecReal<T> sum = VecReal<T>();
+		for (size_t i = DIM; i--; sum += ((VecReal<T>)lhs[i] - (VecReal<T>)rhs[i]) * ((VecReal<T>)lhs[i] - (VecReal<T>)rhs[i]));
 		return sum;
 	}
 
 	template<size_t DIM, typename T>
-	double distance(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
+	constexpr VecReal<T> distance(const vec<DIM, T>& lhs, const vec<DIM, T>& rhs)
 	{
-		return std::sqrt(sqrdistance(lhs, rhs));
+		return detail::sqrt(sqrdistance(lhs, rhs));
 	}
 
-	//determinant for 3x3 matrices - TODO ADD TO MATRIX HEADER
+	//determinant of the 3x3 matrix with the rows v1, v2, v3, mat.h has determinant() for mat
 	template <typename T>
-	double determinant(const vec<3, T>& v1, const vec<3, T>& v2, const vec<3, T>& v3)
+	constexpr T determinant(const vec<3, T>& v1, const vec<3, T>& v2, const vec<3, T>& v3)
 	{
 		return (v1.x * (v2.y * v3.z - v2.z * v3.y) - v2.x * (v1.y * v3.z - v1.z * v3.y) + v3.x * (v1.y * v2.z - v1.z * v2.y));
 	}
-};
\ No newline at end of file
+};
+
+#include "vecSimd.h"
+namespace lameutil
+{
+	//fast 1 / sqrt(x) for positive normal x. The float version refines the SSE estimate with one Newton step, the
+	//measured relative error is below 2^-22 (about 3 ulp, exact 1 / std::sqrt is within 1 ulp). With AVX-512 the
+	//double version refines the 14 bit estimate with two Newton steps, relative error below 2^-50. Without the
+	//instruction set both compute 1 / std::sqrt(x). 0 returns inf or NaN, denormals are not supported.
+	inline float rsqrt(float x)
+	{
+#if LAME_VEC_SSE
+		const __m128 v = _mm_set_ss(x);
+		const __m128 y = _mm_rsqrt_ss(v);
+		const __m128 h = _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), v), _mm_mul_ss(y, y));
+		return _mm_cvtss_f32(_mm_mul_ss(y, _mm_sub_ss(_mm_set_ss(1.5f), h)));
+#else
+		return 1 / std::sqrt(x);
+#endif
+	}
+
+	inline double rsqrt(double x)
+	{
+#if LAME_VEC_SSE && defined(__AVX512F__)
+		const __m128d v = _mm_set_sd(x);
+		double y = _mm_cvtsd_f64(_mm_rsqrt14_sd(v, v));
+		y = y * (1.5 - 0.5 * x * y * y);
+		return y * (1.5 - 0.5 * x * y * y);
+#else
+		return 1 / std::sqrt(x);
+#endif
+	}
+
+	inline long double rsqrt(long double x)
+	{
+		return 1 / std::sqrt(x);
+	}
+
+	//v / v.norm() computed with rsqrt, for float vectors faster than normalize() at the cost of a few ulp.
+	//The zero vector gives NaN components.
+	template <size_t DIM, typename T>
+	inline vec<DIM, T> fastNormalize(const vec<DIM, T>& v)
+	{
+		return v * rsqrt(v.sqrnorm());
+	}
+}
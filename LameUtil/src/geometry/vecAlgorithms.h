@@ -0,0 +1,356 @@
+#pragma once
+#include <cstddef>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "vec.h"
+#include "mat.h"
+#include "../parallel.h"
+
+/*
+Parallel reductions and transforms over arrays of vec.
+
+The array is cut into blocks of a fixed number of points (independent of the thread count), every block is reduced
+on its own and the partial results are combined in block order. Results are therefore bit identical for any number
+of threads. Within a block the components are processed as one flat array with several independent accumulators
+per component, which the compiler turns into SIMD code without the dependency chain of a single running sum.
+Partial sums of blocks are combined in double.
+
+
+R reduceBlocks(size_t n, R init, F block, C combine, unsigned threads = hardwareThreads())
+The deterministic reduction behind the functions below: block(lo, hi) reduces [lo, hi> to an R, combine(a, b)
+merges two results. init is combined with the first block result.
+
+BoundingBox<DIM, T> boundingBox(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+Component-wise minimum lo and maximum hi. For an empty array lo is +max and hi is -max.
+
+vec<DIM, T> centroid(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+The mean of the points.
+
+mat<DIM, DIM, T> covariance(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+The covariance matrix (divided by n) around the centroid, computed in two passes for stability.
+
+double sumOfNorms(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+The sum of norm() of all points.
+
+void normalizeAll(std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+Normalizes every vector, zero vectors are left unchanged.
+
+size_t nearestTo(const std::vector<vec<DIM, T>>& points, const vec<DIM, T>& q, unsigned threads = hardwareThreads())
+Index of the point closest to q, the lowest index on ties. The array must not be empty.
+
+
+Example:
+
+lameutil::BoundingBox<3, float> box = lameutil::boundingBox(points);
+lameutil::Vec3f center = lameutil::centroid(points);
+lameutil::Mat3f cov = lameutil::covariance(points);
+
+Timings for 10^7 Vec3f, single core, -O2 -mavx2 -mfma, plain loop with vec operators vs batch function:
+	boundingBox     ~4.7 ms vs ~2.8 ms
+	centroid        ~6.5 ms vs ~3.7 ms (the plain loop summing into a Vec3d)
+	covariance      ~90 ms vs ~40 ms
+	sumOfNorms      ~17 ms vs ~10 ms
+	normalizeAll    ~26 ms vs ~18 ms
+	nearestTo       ~10 ms vs ~10 ms (memory bound, only threads help)
+*/
+
+namespace lameutil
+{
+	template <size_t DIM, typename T>
+	struct BoundingBox
+	{
+		vec<DIM, T> lo;
+		vec<DIM, T> hi;
+	};
+
+	template <typename R, typename F, typename C>
+	R reduceBlocks(size_t n, R init, F block, C combine, unsigned threads = hardwareThreads())
+	{
+		const size_t blockSize = 8192;
+		std::vector<R> partial(chunkCount(0, n, blockSize));
+		parallelFor(0, n, blockSize, [&](size_t lo, size_t hi)
+		{
+			partial[lo / blockSize] = block(lo, hi);
+		}, threads);
+		for(const R& r : partial)
+		{
+			init = combine(init, r);
+		}
+		return init;
+	}
+
+	namespace detail
+	{
+		//accumulators per component, enough independent lanes for 8 wide SIMD and latency hiding
+		constexpr size_t flatLanes = 16;
+
+		//the components of points [lo, hi> as one array, with S values per point (S > DIM for padded vec types)
+		template <size_t DIM, typename T>
+		struct FlatView
+		{
+			static constexpr size_t S = sizeof(vec<DIM, T>) / sizeof(T);
+			static_assert(sizeof(vec<DIM, T>) % sizeof(T) == 0, "vec is expected to be an array of its components.");
+
+			const T* data;
+			size_t count;
+
+			FlatView(const vec<DIM, T>* points, size_t lo, size_t hi) : data(&points[lo][0]), count((hi - lo) * S)
+			{
+			}
+
+			//calls f(k, value) for all values, where k < S * flatLanes and k % S is the component of the value
+			template <typename F>
+			void run(F f) const
+			{
+				size_t i = 0;
+				for(; i + S * flatLanes <= count; i += S * flatLanes)
+				{
+					for(size_t k = 0; k < S * flatLanes; k++)
+					{
+						f(k, data[i + k]);
+					}
+				}
+				for(size_t k = 0; i < count; i++, k++)
+				{
+					f(k, data[i]);
+				}
+			}
+		};
+	}
+
+	template <size_t DIM, typename T>
+	BoundingBox<DIM, T> boundingBox(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+	{
+		typedef detail::FlatView<DIM, T> View;
+		BoundingBox<DIM, T> init;
+		for(size_t d = 0; d < DIM; d++)
+		{
+			init.lo[d] = std::numeric_limits<T>::max();
+			init.hi[d] = std::numeric_limits<T>::lowest();
+		}
+		return reduceBlocks(points.size(), init, [&](size_t lo, size_t hi)
+		{
+			const View view(points.data(), lo, hi);
+			T low[View::S * detail::flatLanes], high[View::S * detail::flatLanes];
+			std::fill(low, low + View::S * detail::flatLanes, std::numeric_limits<T>::max());
+			std::fill(high, high + View::S * detail::flatLanes, std::numeric_limits<T>::lowest());
+			view.run([&](size_t k, T v)
+			{
+				low[k] = v < low[k] ? v : low[k];
+				high[k] = v > high[k] ? v : high[k];
+			});
+			BoundingBox<DIM, T> box = init;
+			for(size_t k = 0; k < View::S * detail::flatLanes; k++)
+			{
+				if(k % View::S < DIM)
+				{
+					box.lo[k % View::S] = std::min(box.lo[k % View::S], low[k]);
+					box.hi[k % View::S] = std::max(box.hi[k % View::S], high[k]);
+				}
+			}
+			return box;
+		}, [](const BoundingBox<DIM, T>& a, const BoundingBox<DIM, T>& b)
+		{
+			BoundingBox<DIM, T> box;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				box.lo[d] = std::min(a.lo[d], b.lo[d]);
+				box.hi[d] = std::max(a.hi[d], b.hi[d]);
+			}
+			return box;
+		}, threads);
+	}
+
+	template <size_t DIM, typename T>
+	vec<DIM, T> centroid(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+	{
+		typedef detail::FlatView<DIM, T> View;
+		const vec<DIM, double> sum = reduceBlocks(points.size(), vec<DIM, double>(), [&](size_t lo, size_t hi)
+		{
+			const View view(points.data(), lo, hi);
+			T acc[View::S * detail::flatLanes] = {};
+			view.run([&](size_t k, T v) { acc[k] += v; });
+			vec<DIM, double> s;
+			for(size_t k = 0; k < View::S * detail::flatLanes; k++)
+			{
+				if(k % View::S < DIM)
+				{
+					s[k % View::S] += acc[k];
+				}
+			}
+			return s;
+		}, [](const vec<DIM, double>& a, const vec<DIM, double>& b)
+		{
+			vec<DIM, double> s;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				s[d] = a[d] + b[d];
+			}
+			return s;
+		}, threads);
+
+		vec<DIM, T> ret;
+		for(size_t d = 0; d < DIM; d++)
+		{
+			ret[d] = points.empty() ? T() : (T)(sum[d] / (double)points.size());
+		}
+		return ret;
+	}
+
+	template <size_t DIM, typename T>
+	mat<DIM, DIM, T> covariance(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+	{
+		const vec<DIM, T> c = centroid(points, threads);
+		typedef mat<DIM, DIM, double> Sum;
+		const Sum sum = reduceBlocks(points.size(), Sum(), [&](size_t lo, size_t hi)
+		{
+			//the upper triangle, 4 points per step into independent accumulators
+			const size_t lanes = 4;
+			T acc[DIM][DIM][lanes] = {};
+			size_t i = lo;
+			for(; i + lanes <= hi; i += lanes)
+			{
+				for(size_t l = 0; l < lanes; l++)
+				{
+					T v[DIM];
+					for(size_t d = 0; d < DIM; d++)
+					{
+						v[d] = points[i + l][d] - c[d];
+					}
+					for(size_t r = 0; r < DIM; r++)
+					{
+						for(size_t s = r; s < DIM; s++)
+						{
+							acc[r][s][l] += v[r] * v[s];
+						}
+					}
+				}
+			}
+			for(; i < hi; i++)
+			{
+				for(size_t r = 0; r < DIM; r++)
+				{
+					for(size_t s = r; s < DIM; s++)
+					{
+						acc[r][s][0] += (points[i][r] - c[r]) * (points[i][s] - c[s]);
+					}
+				}
+			}
+			Sum m;
+			for(size_t r = 0; r < DIM; r++)
+			{
+				for(size_t s = r; s < DIM; s++)
+				{
+					double t = 0;
+					for(size_t l = 0; l < lanes; l++)
+					{
+						t += acc[r][s][l];
+					}
+					m(r, s) = t;
+				}
+			}
+			return m;
+		}, [](const Sum& a, const Sum& b) { return a + b; }, threads);
+
+		mat<DIM, DIM, T> ret;
+		const double scale = points.empty() ? 0 : 1 / (double)points.size();
+		for(size_t r = 0; r < DIM; r++)
+		{
+			for(size_t s = r; s < DIM; s++)
+			{
+				ret(r, s) = ret(s, r) = (T)(sum(r, s) * scale);
+			}
+		}
+		return ret;
+	}
+
+	template <size_t DIM, typename T>
+	double sumOfNorms(const std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+	{
+		return reduceBlocks(points.size(), 0.0, [&](size_t lo, size_t hi)
+		{
+			const size_t lanes = detail::flatLanes;
+			T acc[lanes] = {};
+			size_t i = lo;
+			for(; i + lanes <= hi; i += lanes)
+			{
+				for(size_t l = 0; l < lanes; l++)
+				{
+					T s = T();
+					for(size_t d = 0; d < DIM; d++)
+					{
+						s += points[i + l][d] * points[i + l][d];
+					}
+					acc[l] += std::sqrt(s);
+				}
+			}
+			double sum = 0;
+			for(size_t l = 0; l < lanes; l++)
+			{
+				sum += acc[l];
+			}
+			for(; i < hi; i++)
+			{
+				sum += points[i].norm();
+			}
+			return sum;
+		}, [](double a, double b) { return a + b; }, threads);
+	}
+
+	template <size_t DIM, typename T>
+	void normalizeAll(std::vector<vec<DIM, T>>& points, unsigned threads = hardwareThreads())
+	{
+		parallelFor(0, points.size(), 8192, [&](size_t lo, size_t hi)
+		{
+			for(size_t i = lo; i < hi; i++)
+			{
+				T s = T();
+				for(size_t d = 0; d < DIM; d++)
+				{
+					s += points[i][d] * points[i][d];
+				}
+				const T scale = s > 0 ? T(1) / std::sqrt(s) : T(1);
+				for(size_t d = 0; d < DIM; d++)
+				{
+					points[i][d] *= scale;
+				}
+			}
+		}, threads);
+	}
+
+	template <size_t DIM, typename T>
+	size_t nearestTo(const std::vector<vec<DIM, T>>& points, const vec<DIM, T>& q, unsigned threads = hardwareThreads())
+	{
+		assert(!points.empty());
+		struct Best
+		{
+			T sqrDistance;
+			size_t index;
+		};
+		const Best best = reduceBlocks(points.size(), Best{std::numeric_limits<T>::max(), 0}, [&](size_t lo, size_t hi)
+		{
+			Best b{std::numeric_limits<T>::max(), lo};
+			for(size_t i = lo; i < hi; i++)
+			{
+				T s = T();
+				for(size_t d = 0; d < DIM; d++)
+				{
+					const T diff = points[i][d] - q[d];
+					s += diff * diff;
+				}
+				if(s < b.sqrDistance)
+				{
+					b = Best{s, i};
+				}
+			}
+			return b;
+		}, [](const Best& a, const Best& b)
+		{
+			return b.sqrDistance < a.sqrDistance ? b : a;
+		}, threads);
+		return best.index;
+	}
+}
@@ -0,0 +1,881 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include "vec.h"
+#include "../cpuDispatch.h"
+
+/*
+Structure of arrays container for large sets of vectors.
+
+VecArray<DIM, T> keeps every component in its own contiguous 64 byte aligned array (all x, then all y, ...),
+so kernels which only touch some components read only those and the batch kernels below process 4-8 elements
+per instruction. Elements are read and written as vec<DIM, T> through proxies.
+
+
+VecArray<DIM, T>() / explicit VecArray(size_t n) / VecArray(const std::vector<vec<DIM, T>>& v) / VecArray(const vec<DIM, T>* v, size_t n)
+Constructs n zero vectors or a copy of an array of structures.
+
+vec<DIM, T> operator[](size_t i) const / Reference operator[](size_t i)
+Element access, the reference converts to vec<DIM, T>, can be assigned one and its components are accessed with [].
+Templates like operator* or distance do not deduce through the conversion, use get(i) or a const VecArray& there.
+
+vec<DIM, T> get(size_t i) const / void set(size_t i, const vec<DIM, T>& v)
+Reads or writes element i.
+
+T* data(size_t c) / const T* data(size_t c) const
+The array of component c.
+
+void push_back(const vec<DIM, T>& v), resize(size_t n), reserve(size_t n), clear(), size(), capacity()
+Same as for std::vector.
+
+void assign(const vec<DIM, T>* v, size_t n) / void copyTo(vec<DIM, T>* out) const / std::vector<vec<DIM, T>> toVector() const
+Conversion from and to arrays of structures.
+
+Batch kernels, out may be one of the inputs:
+	void add(const VecArray& a, const VecArray& b, VecArray& out)     out[i] = a[i] + b[i]
+	void sub(const VecArray& a, const VecArray& b, VecArray& out)     out[i] = a[i] - b[i]
+	void add(const VecArray& a, const vec<DIM, T>& v, VecArray& out)  out[i] = a[i] + v
+	void scale(const VecArray& a, T s, VecArray& out)                 out[i] = a[i] * s
+	void dot(const VecArray& a, const VecArray& b, T* out)            out[i] = a[i] * b[i]
+	void norm(const VecArray& a, T* out)                              out[i] = a[i].norm()
+	void normalize(VecArray& a)                                       a[i].normalize()
+	void fastNormalize(VecArray& a)                                   a[i] = fastNormalize(a[i])
+	void distance(const VecArray& a, const vec<DIM, T>& p, T* out)    out[i] = distance(a[i], p)
+	void sqrdistance(const VecArray& a, const vec<DIM, T>& p, T* out) out[i] = sqrdistance(a[i], p)
+float and double use SSE/AVX (whichever the compiler targets), other types fall back to scalar loops. The float
+norm, normalize, distance and sqrdistance pick SSE4.2, AVX2 or AVX-512 at runtime (see cpuDispatch.h).
+
+
+Example:
+
+std::vector<lameutil::Vec3f> points = loadPoints();
+lameutil::VecArray<3, float> soa(points);
+std::vector<float> dist(soa.size());
+lameutil::distance(soa, lameutil::Vec3f(1, 2, 3), dist.data());
+soa[0] = lameutil::Vec3f(0, 0, 0);
+float y = soa[1][1];
+
+Timings for 10^7 Vec3f, single core, -O2 -mavx2, loop over std::vector<Vec3f> vs VecArray kernel:
+	distance to point   ~21 ms vs ~4 ms
+	normalize           ~28 ms vs ~4 ms
+	dot                 ~7 ms vs ~6 ms (memory bound either way)
+	AoS -> SoA ~8 ms, SoA -> AoS ~8 ms
+*/
+
+#if LAME_VEC_SSE
+#include <immintrin.h>
+#endif
+
+namespace lameutil
+{
+	namespace detail
+	{
+		//one element, the tail of every batch kernel and the fallback for types without SIMD support
+		template <typename T>
+		struct ScalarPack
+		{
+			static constexpr size_t width = 1;
+			T v;
+
+			static ScalarPack load(const T* p) { return ScalarPack{*p}; }
+			static ScalarPack set1(T s) { return ScalarPack{s}; }
+			void store(T* p) const { *p = v; }
+			friend ScalarPack operator+(ScalarPack a, ScalarPack b) { return ScalarPack{a.v + b.v}; }
+			friend ScalarPack operator-(ScalarPack a, ScalarPack b) { return ScalarPack{a.v - b.v}; }
+			friend ScalarPack operator*(ScalarPack a, ScalarPack b) { return ScalarPack{a.v * b.v}; }
+			friend ScalarPack operator/(ScalarPack a, ScalarPack b) { return ScalarPack{a.v / b.v}; }
+			friend ScalarPack sqrt(ScalarPack a) { return ScalarPack{(T)std::sqrt(a.v)}; }
+			friend ScalarPack rsqrt(ScalarPack a) { return ScalarPack{(T)lameutil::rsqrt(a.v)}; }
+		};
+
+		template <typename T>
+		struct SimdPackOf
+		{
+			typedef ScalarPack<T> type;
+		};
+
+#if LAME_VEC_AVX
+		struct FloatPack
+		{
+			static constexpr size_t width = 8;
+			__m256 v;
+
+			static FloatPack load(const float* p) { return FloatPack{_mm256_loadu_ps(p)}; }
+			static FloatPack set1(float s) { return FloatPack{_mm256_set1_ps(s)}; }
+			void store(float* p) const { _mm256_storeu_ps(p, v); }
+			friend FloatPack operator+(FloatPack a, FloatPack b) { return FloatPack{_mm256_add_ps(a.v, b.v)}; }
+			friend FloatPack operator-(FloatPack a, FloatPack b) { return FloatPack{_mm256_sub_ps(a.v, b.v)}; }
+			friend FloatPack operator*(FloatPack a, FloatPack b) { return FloatPack{_mm256_mul_ps(a.v, b.v)}; }
+			friend FloatPack operator/(FloatPack a, FloatPack b) { return FloatPack{_mm256_div_ps(a.v, b.v)}; }
+			friend FloatPack sqrt(FloatPack a) { return FloatPack{_mm256_sqrt_ps(a.v)}; }
+			friend FloatPack rsqrt(FloatPack a)
+			{
+				const __m256 y = _mm256_rsqrt_ps(a.v);
+				const __m256 h = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), a.v), _mm256_mul_ps(y, y));
+				return FloatPack{_mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), h))};
+			}
+		};
+
+		struct DoublePack
+		{
+			static constexpr size_t width = 4;
+			__m256d v;
+
+			static DoublePack load(const double* p) { return DoublePack{_mm256_loadu_pd(p)}; }
+			static DoublePack set1(double s) { return DoublePack{_mm256_set1_pd(s)}; }
+			void store(double* p) const { _mm256_storeu_pd(p, v); }
+			friend DoublePack operator+(DoublePack a, DoublePack b) { return DoublePack{_mm256_add_pd(a.v, b.v)}; }
+			friend DoublePack operator-(DoublePack a, DoublePack b) { return DoublePack{_mm256_sub_pd(a.v, b.v)}; }
+			friend DoublePack operator*(DoublePack a, DoublePack b) { return DoublePack{_mm256_mul_pd(a.v, b.v)}; }
+			friend DoublePack operator/(DoublePack a, DoublePack b) { return DoublePack{_mm256_div_pd(a.v, b.v)}; }
+			friend DoublePack sqrt(DoublePack a) { return DoublePack{_mm256_sqrt_pd(a.v)}; }
+			friend DoublePack rsqrt(DoublePack a) { return DoublePack{_mm256_div_pd(_mm256_set1_pd(1), _mm256_sqrt_pd(a.v))}; }
+		};
+#elif LAME_VEC_SSE
+		struct FloatPack
+		{
+			static constexpr size_t width = 4;
+			__m128 v;
+
+			static FloatPack load(const float* p) { return FloatPack{_mm_loadu_ps(p)}; }
+			static FloatPack set1(float s) { return FloatPack{_mm_set1_ps(s)}; }
+			void store(float* p) const { _mm_storeu_ps(p, v); }
+			friend FloatPack operator+(FloatPack a, FloatPack b) { return FloatPack{_mm_add_ps(a.v, b.v)}; }
+			friend FloatPack operator-(FloatPack a, FloatPack b) { return FloatPack{_mm_sub_ps(a.v, b.v)}; }
+			friend FloatPack operator*(FloatPack a, FloatPack b) { return FloatPack{_mm_mul_ps(a.v, b.v)}; }
+			friend FloatPack operator/(FloatPack a, FloatPack b) { return FloatPack{_mm_div_ps(a.v, b.v)}; }
+			friend FloatPack sqrt(FloatPack a) { return FloatPack{_mm_sqrt_ps(a.v)}; }
+			friend FloatPack rsqrt(FloatPack a) { return FloatPack{detail::rsqrt4(a.v)}; }
+		};
+
+		struct DoublePack
+		{
+			static constexpr size_t width = 2;
+			__m128d v;
+
+			static DoublePack load(const double* p) { return DoublePack{_mm_loadu_pd(p)}; }
+			static DoublePack set1(double s) { return DoublePack{_mm_set1_pd(s)}; }
+			void store(double* p) const { _mm_storeu_pd(p, v); }
+			friend DoublePack operator+(DoublePack a, DoublePack b) { return DoublePack{_mm_add_pd(a.v, b.v)}; }
+			friend DoublePack operator-(DoublePack a, DoublePack b) { return DoublePack{_mm_sub_pd(a.v, b.v)}; }
+			friend DoublePack operator*(DoublePack a, DoublePack b) { return DoublePack{_mm_mul_pd(a.v, b.v)}; }
+			friend DoublePack operator/(DoublePack a, DoublePack b) { return DoublePack{_mm_div_pd(a.v, b.v)}; }
+			friend DoublePack sqrt(DoublePack a) { return DoublePack{_mm_sqrt_pd(a.v)}; }
+			friend DoublePack rsqrt(DoublePack a) { return DoublePack{_mm_div_pd(_mm_set1_pd(1), _mm_sqrt_pd(a.v))}; }
+		};
+#endif
+#if LAME_VEC_SSE
+		template <>
+		struct SimdPackOf<float>
+		{
+			typedef FloatPack type;
+		};
+
+		template <>
+		struct SimdPackOf<double>
+		{
+			typedef DoublePack type;
+		};
+#endif
+
+		//calls f(pack, i) for [0, n> in SIMD steps followed by a scalar tail
+		template <typename T, typename F>
+		void forEachPack(size_t n, F f)
+		{
+			typedef typename SimdPackOf<T>::type P;
+			size_t i = 0;
+			for(; i + P::width <= n; i += P::width)
+			{
+				f(P(), i);
+			}
+			for(; i < n; i++)
+			{
+				f(ScalarPack<T>(), i);
+			}
+		}
+	}
+
+#if LAME_CPU_DISPATCH
+	namespace detail
+	{
+		//the float kernels behind norm, normalize, distance and sqrdistance, one build per instruction set level.
+		//dim and the component arrays are passed at runtime so every VecArray<DIM, float> shares them. Products and
+		//sums are kept apart (no fused multiply-add), so all levels round exactly like the scalar loop.
+		typedef void VecDistanceKernel(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root);
+		typedef void VecNormalizeKernel(float* const* comp, size_t dim, size_t n);
+
+		LAME_NO_CONTRACT inline void vecDistanceFrom(size_t i, const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			for(; i < n; i++)
+			{
+				float sum = 0;
+				for(size_t c = 0; c < dim; c++)
+				{
+					const float d = comp[c][i] - point[c];
+					const float sq = d * d;
+					sum = sum + sq;
+				}
+				out[i] = root ? std::sqrt(sum) : sum;
+			}
+		}
+
+		LAME_NO_CONTRACT inline void vecNormalizeFrom(size_t i, float* const* comp, size_t dim, size_t n)
+		{
+			for(; i < n; i++)
+			{
+				float sum = 0;
+				for(size_t c = 0; c < dim; c++)
+				{
+					const float sq = comp[c][i] * comp[c][i];
+					sum = sum + sq;
+				}
+				const float len = std::sqrt(sum);
+				for(size_t c = 0; c < dim; c++)
+				{
+					comp[c][i] = comp[c][i] / len;
+				}
+			}
+		}
+
+		LAME_NO_CONTRACT inline void vecDistanceScalar(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			vecDistanceFrom(0, comp, dim, point, n, out, root);
+		}
+
+		LAME_NO_CONTRACT inline void vecNormalizeScalar(float* const* comp, size_t dim, size_t n)
+		{
+			vecNormalizeFrom(0, comp, dim, n);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_SSE42 inline void vecDistanceSse42(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			size_t i = 0;
+			for(; i + 4 <= n; i += 4)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m128 d = _mm_sub_ps(_mm_loadu_ps(comp[c] + i), _mm_set1_ps(point[c]));
+					sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+				}
+				_mm_storeu_ps(out + i, root ? _mm_sqrt_ps(sum) : sum);
+			}
+			vecDistanceFrom(i, comp, dim, point, n, out, root);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_SSE42 inline void vecNormalizeSse42(float* const* comp, size_t dim, size_t n)
+		{
+			size_t i = 0;
+			for(; i + 4 <= n; i += 4)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m128 x = _mm_loadu_ps(comp[c] + i);
+					sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+				}
+				const __m128 len = _mm_sqrt_ps(sum);
+				for(size_t c = 0; c < dim; c++)
+				{
+					_mm_storeu_ps(comp[c] + i, _mm_div_ps(_mm_loadu_ps(comp[c] + i), len));
+				}
+			}
+			vecNormalizeFrom(i, comp, dim, n);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_AVX2 inline void vecDistanceAvx2(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			size_t i = 0;
+			for(; i + 8 <= n; i += 8)
+			{
+				__m256 sum = _mm256_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m256 d = _mm256_sub_ps(_mm256_loadu_ps(comp[c] + i), _mm256_set1_ps(point[c]));
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(d, d));
+				}
+				_mm256_storeu_ps(out + i, root ? _mm256_sqrt_ps(sum) : sum);
+			}
+			vecDistanceFrom(i, comp, dim, point, n, out, root);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_AVX2 inline void vecNormalizeAvx2(float* const* comp, size_t dim, size_t n)
+		{
+			size_t i = 0;
+			for(; i + 8 <= n; i += 8)
+			{
+				__m256 sum = _mm256_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m256 x = _mm256_loadu_ps(comp[c] + i);
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+				}
+				const __m256 len = _mm256_sqrt_ps(sum);
+				for(size_t c = 0; c < dim; c++)
+				{
+					_mm256_storeu_ps(comp[c] + i, _mm256_div_ps(_mm256_loadu_ps(comp[c] + i), len));
+				}
+			}
+			vecNormalizeFrom(i, comp, dim, n);
+		}
+
+		//_mm512_sqrt_ps merges into an undefined register, which GCC reports as maybe uninitialized at -O2
+		LAME_TARGET_AVX512 inline __m512 sqrt16(__m512 x)
+		{
+			return _mm512_mask_sqrt_ps(_mm512_setzero_ps(), (__mmask16)0xffff, x);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_AVX512 inline void vecDistanceAvx512(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			size_t i = 0;
+			for(; i + 16 <= n; i += 16)
+			{
+				__m512 sum = _mm512_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m512 d = _mm512_sub_ps(_mm512_loadu_ps(comp[c] + i), _mm512_set1_ps(point[c]));
+					sum = _mm512_add_ps(sum, _mm512_mul_ps(d, d));
+				}
+				_mm512_storeu_ps(out + i, root ? sqrt16(sum) : sum);
+			}
+			vecDistanceFrom(i, comp, dim, point, n, out, root);
+		}
+
+		LAME_NO_CONTRACT LAME_TARGET_AVX512 inline void vecNormalizeAvx512(float* const* comp, size_t dim, size_t n)
+		{
+			size_t i = 0;
+			for(; i + 16 <= n; i += 16)
+			{
+				__m512 sum = _mm512_setzero_ps();
+				for(size_t c = 0; c < dim; c++)
+				{
+					const __m512 x = _mm512_loadu_ps(comp[c] + i);
+					sum = _mm512_add_ps(sum, _mm512_mul_ps(x, x));
+				}
+				const __m512 len = sqrt16(sum);
+				for(size_t c = 0; c < dim; c++)
+				{
+					_mm512_storeu_ps(comp[c] + i, _mm512_div_ps(_mm512_loadu_ps(comp[c] + i), len));
+				}
+			}
+			vecNormalizeFrom(i, comp, dim, n);
+		}
+
+		inline void vecDistance(const float* const* comp, size_t dim, const float* point, size_t n, float* out, bool root)
+		{
+			static const Dispatch<VecDistanceKernel> kernel(vecDistanceScalar, vecDistanceSse42, vecDistanceAvx2, vecDistanceAvx512);
+			kernel(comp, dim, point, n, out, root);
+		}
+
+		inline void vecNormalize(float* const* comp, size_t dim, size_t n)
+		{
+			static const Dispatch<VecNormalizeKernel> kernel(vecNormalizeScalar, vecNormalizeSse42, vecNormalizeAvx2, vecNormalizeAvx512);
+			kernel(comp, dim, n);
+		}
+	}
+#endif
+
+	template <typename E, size_t DIM, typename T>
+	struct VecExpr;
+
+	template <size_t DIM, typename T>
+	class VecArray
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "VecArray needs trivially copyable components.");
+
+	private:
+		static constexpr size_t alignment = 64;
+		//every component array starts on its own cache line
+		static constexpr size_t granularity = alignment / sizeof(T) ? alignment / sizeof(T) : 1;
+
+		T* buffer = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+
+	public:
+		class Reference
+		{
+		private:
+			VecArray* array;
+			size_t i;
+
+		public:
+			Reference(VecArray* array, size_t i) : array(array), i(i)
+			{
+			}
+
+			operator vec<DIM, T>() const
+			{
+				return array->get(i);
+			}
+
+			Reference& operator=(const vec<DIM, T>& v)
+			{
+				array->set(i, v);
+				return *this;
+			}
+
+			Reference& operator=(const Reference& other)
+			{
+				array->set(i, other);
+				return *this;
+			}
+
+			T& operator[](size_t c) const
+			{
+				assert(c < DIM);
+				return array->data(c)[i];
+			}
+		};
+
+		VecArray()
+		{
+			resize(0);
+		}
+
+		explicit VecArray(size_t n)
+		{
+			resize(n);
+		}
+
+		VecArray(const vec<DIM, T>* v, size_t n)
+		{
+			assign(v, n);
+		}
+
+		VecArray(const std::vector<vec<DIM, T>>& v)
+		{
+			assign(v.data(), v.size());
+		}
+
+		//evaluates an expression from vecExpr.h
+		template <typename E>
+		VecArray(const VecExpr<E, DIM, T>& e)
+		{
+			e.evaluateTo(*this);
+		}
+
+		template <typename E>
+		VecArray& operator=(const VecExpr<E, DIM, T>& e)
+		{
+			e.evaluateTo(*this);
+			return *this;
+		}
+
+		VecArray(const VecArray& other)
+		{
+			reserve(other.count);
+			count = other.count;
+			for(size_t c = 0; c < DIM; c++)
+			{
+				std::memcpy(data(c), other.data(c), count * sizeof(T));
+			}
+		}
+
+		VecArray(VecArray&& other) noexcept : buffer(other.buffer), count(other.count), stride(other.stride)
+		{
+			other.buffer = nullptr;
+			other.count = other.stride = 0;
+		}
+
+		VecArray& operator=(VecArray other) noexcept
+		{
+			swap(other);
+			return *this;
+		}
+
+		~VecArray()
+		{
+			release(buffer);
+		}
+
+		void swap(VecArray& other) noexcept
+		{
+			std::swap(buffer, other.buffer);
+			std::swap(count, other.count);
+			std::swap(stride, other.stride);
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		size_t capacity() const
+		{
+			return stride;
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		T* data(size_t c)
+		{
+			assert(c < DIM);
+			return buffer + c * stride;
+		}
+
+		const T* data(size_t c) const
+		{
+			assert(c < DIM);
+			return buffer + c * stride;
+		}
+
+		vec<DIM, T> get(size_t i) const
+		{
+			assert(i < count);
+			vec<DIM, T> ret;
+			for(size_t c = 0; c < DIM; c++)
+			{
+				ret[c] = buffer[c * stride + i];
+			}
+			return ret;
+		}
+
+		void set(size_t i, const vec<DIM, T>& v)
+		{
+			assert(i < count);
+			for(size_t c = 0; c < DIM; c++)
+			{
+				buffer[c * stride + i] = v[c];
+			}
+		}
+
+		vec<DIM, T> operator[](size_t i) const
+		{
+			return get(i);
+		}
+
+		Reference operator[](size_t i)
+		{
+			assert(i < count);
+			return Reference(this, i);
+		}
+
+		void reserve(size_t n)
+		{
+			if(n <= stride)
+			{
+				return;
+			}
+			const size_t newStride = (n + granularity - 1) / granularity * granularity;
+			T* newBuffer = static_cast<T*>(::operator new(DIM * newStride * sizeof(T), std::align_val_t(alignment)));
+			for(size_t c = 0; c < DIM && count; c++)
+			{
+				std::memcpy(newBuffer + c * newStride, buffer + c * stride, count * sizeof(T));
+			}
+			release(buffer);
+			buffer = newBuffer;
+			stride = newStride;
+		}
+
+		void resize(size_t n)
+		{
+			reserve(n);
+			for(size_t c = 0; c < DIM && n > count; c++)
+			{
+				std::fill(data(c) + count, data(c) + n, T());
+			}
+			count = n;
+		}
+
+		void clear()
+		{
+			count = 0;
+		}
+
+		void push_back(const vec<DIM, T>& v)
+		{
+			if(count == stride)
+			{
+				reserve(stride ? 2 * stride : granularity);
+			}
+			count++;
+			set(count - 1, v);
+		}
+
+		void assign(const vec<DIM, T>* v, size_t n)
+		{
+			count = 0;
+			reserve(n);
+			count = n;
+			T* out[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				out[c] = data(c);
+			}
+			for(size_t i = 0; i < n; i++)
+			{
+				for(size_t c = 0; c < DIM; c++)
+				{
+					out[c][i] = v[i][c];
+				}
+			}
+		}
+
+		void copyTo(vec<DIM, T>* out) const
+		{
+			const T* in[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				in[c] = data(c);
+			}
+			for(size_t i = 0; i < count; i++)
+			{
+				for(size_t c = 0; c < DIM; c++)
+				{
+					out[i][c] = in[c][i];
+				}
+			}
+		}
+
+		std::vector<vec<DIM, T>> toVector() const
+		{
+			std::vector<vec<DIM, T>> ret(count);
+			copyTo(ret.data());
+			return ret;
+		}
+
+	private:
+		static void release(T* p)
+		{
+			if(p)
+			{
+				::operator delete(p, std::align_val_t(alignment));
+			}
+		}
+	};
+
+	template <size_t DIM, typename T>
+	void add(const VecArray<DIM, T>& a, const VecArray<DIM, T>& b, VecArray<DIM, T>& out)
+	{
+		assert(a.size() == b.size());
+		out.resize(a.size());
+		for(size_t c = 0; c < DIM; c++)
+		{
+			const T* pa = a.data(c);
+			const T* pb = b.data(c);
+			T* po = out.data(c);
+			detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+			{
+				typedef decltype(p) P;
+				(P::load(pa + i) + P::load(pb + i)).store(po + i);
+			});
+		}
+	}
+
+	template <size_t DIM, typename T>
+	void sub(const VecArray<DIM, T>& a, const VecArray<DIM, T>& b, VecArray<DIM, T>& out)
+	{
+		assert(a.size() == b.size());
+		out.resize(a.size());
+		for(size_t c = 0; c < DIM; c++)
+		{
+			const T* pa = a.data(c);
+			const T* pb = b.data(c);
+			T* po = out.data(c);
+			detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+			{
+				typedef decltype(p) P;
+				(P::load(pa + i) - P::load(pb + i)).store(po + i);
+			});
+		}
+	}
+
+	template <size_t DIM, typename T>
+	void add(const VecArray<DIM, T>& a, const vec<DIM, T>& v, VecArray<DIM, T>& out)
+	{
+		out.resize(a.size());
+		for(size_t c = 0; c < DIM; c++)
+		{
+			const T* pa = a.data(c);
+			T* po = out.data(c);
+			const T s = v[c];
+			detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+			{
+				typedef decltype(p) P;
+				(P::load(pa + i) + P::set1(s)).store(po + i);
+			});
+		}
+	}
+
+	template <size_t DIM, typename T>
+	void scale(const VecArray<DIM, T>& a, T s, VecArray<DIM, T>& out)
+	{
+		out.resize(a.size());
+		for(size_t c = 0; c < DIM; c++)
+		{
+			const T* pa = a.data(c);
+			T* po = out.data(c);
+			detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+			{
+				typedef decltype(p) P;
+				(P::load(pa + i) * P::set1(s)).store(po + i);
+			});
+		}
+	}
+
+	template <size_t DIM, typename T>
+	void dot(const VecArray<DIM, T>& a, const VecArray<DIM, T>& b, T* out)
+	{
+		assert(a.size() == b.size());
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P sum = P::load(a.data(0) + i) * P::load(b.data(0) + i);
+			for(size_t c = 1; c < DIM; c++)
+			{
+				sum = sum + P::load(a.data(c) + i) * P::load(b.data(c) + i);
+			}
+			sum.store(out + i);
+		});
+	}
+
+	template <size_t DIM, typename T>
+	void norm(const VecArray<DIM, T>& a, T* out)
+	{
+#if LAME_CPU_DISPATCH
+		if constexpr(std::is_same<T, float>::value)
+		{
+			const float* comp[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				comp[c] = a.data(c);
+			}
+			const float zero[DIM] = {};
+			detail::vecDistance(comp, DIM, zero, a.size(), out, true);
+			return;
+		}
+#endif
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P sum = P::set1(T());
+			for(size_t c = 0; c < DIM; c++)
+			{
+				const P x = P::load(a.data(c) + i);
+				sum = sum + x * x;
+			}
+			sqrt(sum).store(out + i);
+		});
+	}
+
+	template <size_t DIM, typename T>
+	void normalize(VecArray<DIM, T>& a)
+	{
+#if LAME_CPU_DISPATCH
+		if constexpr(std::is_same<T, float>::value)
+		{
+			float* comp[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				comp[c] = a.data(c);
+			}
+			detail::vecNormalize(comp, DIM, a.size());
+			return;
+		}
+#endif
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P x[DIM];
+			P sum = P::set1(T());
+			for(size_t c = 0; c < DIM; c++)
+			{
+				x[c] = P::load(a.data(c) + i);
+				sum = sum + x[c] * x[c];
+			}
+			const P len = sqrt(sum);
+			for(size_t c = 0; c < DIM; c++)
+			{
+				(x[c] / len).store(a.data(c) + i);
+			}
+		});
+	}
+
+	template <size_t DIM, typename T>
+	void fastNormalize(VecArray<DIM, T>& a)
+	{
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P x[DIM];
+			P sum = P::set1(T());
+			for(size_t c = 0; c < DIM; c++)
+			{
+				x[c] = P::load(a.data(c) + i);
+				sum = sum + x[c] * x[c];
+			}
+			const P scale = rsqrt(sum);
+			for(size_t c = 0; c < DIM; c++)
+			{
+				(x[c] * scale).store(a.data(c) + i);
+			}
+		});
+	}
+
+	template <size_t DIM, typename T>
+	void sqrdistance(const VecArray<DIM, T>& a, const vec<DIM, T>& point, T* out)
+	{
+#if LAME_CPU_DISPATCH
+		if constexpr(std::is_same<T, float>::value)
+		{
+			const float* comp[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				comp[c] = a.data(c);
+			}
+			detail::vecDistance(comp, DIM, &point[0], a.size(), out, false);
+			return;
+		}
+#endif
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P sum = P::set1(T());
+			for(size_t c = 0; c < DIM; c++)
+			{
+				const P d = P::load(a.data(c) + i) - P::set1(point[c]);
+				sum = sum + d * d;
+			}
+			sum.store(out + i);
+		});
+	}
+
+	template <size_t DIM, typename T>
+	void distance(const VecArray<DIM, T>& a, const vec<DIM, T>& point, T* out)
+	{
+#if LAME_CPU_DISPATCH
+		if constexpr(std::is_same<T, float>::value)
+		{
+			const float* comp[DIM];
+			for(size_t c = 0; c < DIM; c++)
+			{
+				comp[c] = a.data(c);
+			}
+			detail::vecDistance(comp, DIM, &point[0], a.size(), out, true);
+			return;
+		}
+#endif
+		detail::forEachPack<T>(a.size(), [&](auto p, size_t i)
+		{
+			typedef decltype(p) P;
+			P sum = P::set1(T());
+			for(size_t c = 0; c < DIM; c++)
+			{
+				const P d = P::load(a.data(c) + i) - P::set1(point[c]);
+				sum = sum + d * d;
+			}
+			sqrt(sum).store(out + i);
+		});
+	}
+}
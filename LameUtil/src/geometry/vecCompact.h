@@ -0,0 +1,510 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <vector>
+#include "vec.h"
+
+/*
+Compact 16 bit storage for vec: half precision, bfloat16 and integers quantized to a bounding box.
+
+The types are meant for storing large point sets and converting them in bulk to and from vec<DIM, float> for
+computation, vec<DIM, half> is 6 bytes for DIM = 3 instead of 12. They convert to float implicitly, so single
+components can be read directly, but vec arithmetic on the compact types is not supported.
+
+	half      - IEEE 754 binary16, 11 bit significand, relative error <= 2^-11, largest finite value 65504,
+	            values below 2^-14 are stored as denormals down to 2^-24
+	bfloat16  - the upper half of a float, 8 bit significand, relative error <= 2^-8, the full float range
+	Quantizer - vec<DIM, uint16_t> in 65535 steps between the corners of a box, absolute error <= step / 2 per
+	            component (plus float rounding), the best choice for bounded point clouds
+
+The half and bfloat16 conversions round to nearest even and keep inf and NaN. The quantizer rounds halfway cases up
+(+ 0.5 and truncation, which vectorizes without SSE4.1) and clamps to the box. With F16C (-mf16c, implied by
+-march=haswell or later) the bulk half conversions use _mm256_cvtps_ph / _mm256_cvtph_ps, without it they are scalar.
+The bulk bfloat16 conversions use SSE2, the quantizer loops run over flat component arrays so the compiler vectorizes
+them. Arrays of the padded SIMD Vec3f (LAME_VEC_SIMD_VEC3) are converted element by element.
+
+
+half(float f) / bfloat16(float f) / operator float() const
+Conversions of single values, explicit to 16 bit and implicit to float.
+
+static half fromBits(uint16_t b) / static bfloat16 fromBits(uint16_t b) / uint16_t bits
+The raw representation.
+
+void convert(const vec<DIM, float>* in, vec<DIM, half>* out, size_t n)
+void convert(const vec<DIM, half>* in, vec<DIM, float>* out, size_t n)
+void convert(const vec<DIM, float>* in, vec<DIM, bfloat16>* out, size_t n)
+void convert(const vec<DIM, bfloat16>* in, vec<DIM, float>* out, size_t n)
+Bulk conversion of n vectors.
+
+std::vector<vec<DIM, half>> toHalf(const std::vector<vec<DIM, float>>& v)
+std::vector<vec<DIM, bfloat16>> toBfloat16(const std::vector<vec<DIM, float>>& v)
+std::vector<vec<DIM, float>> toFloat(const std::vector<vec<DIM, half>>& v) (and for bfloat16)
+The same for whole arrays.
+
+Quantizer<DIM>(const vec<DIM, float>& lo, const vec<DIM, float>& hi)
+Maps [lo, hi] to [0, 65535] per component, values outside are clamped. lo == hi in a component stores 0 there.
+
+vec<DIM, uint16_t> encode(const vec<DIM, float>& p) const / vec<DIM, float> decode(const vec<DIM, uint16_t>& q) const
+void encode(const vec<DIM, float>* in, vec<DIM, uint16_t>* out, size_t n) const
+void decode(const vec<DIM, uint16_t>* in, vec<DIM, float>* out, size_t n) const
+Single and bulk conversion.
+
+vec<DIM, float> step() const
+The distance between two quantization levels per component.
+
+
+Example:
+
+std::vector<lameutil::Vec3h> stored = lameutil::toHalf(points);
+std::vector<lameutil::Vec3f> work = lameutil::toFloat(stored);
+
+lameutil::BoundingBox<3, float> box = lameutil::boundingBox(points); //vecAlgorithms.h
+lameutil::Quantizer<3> quantizer(box.lo, box.hi);
+std::vector<lameutil::Vec3q> packed(points.size());
+quantizer.encode(points.data(), packed.data(), points.size());
+
+Timings for 10^7 Vec3f, single core, -O2 -mavx2 -mfma -mf16c, element by element with the scalar conversion vs bulk:
+	to half         ~7 ms vs ~4 ms (~22 ms either way without F16C)
+	from half       ~6 ms vs ~4 ms
+	to bfloat16     ~15 ms vs ~5 ms
+	from bfloat16   ~6 ms vs ~4 ms
+	encode          ~49 ms vs ~9 ms
+	decode          ~9 ms vs ~4 ms
+*/
+
+#if LAME_VEC_SSE && defined(__F16C__)
+#define LAME_VEC_F16C 1
+#endif
+
+namespace lameutil
+{
+	namespace detail
+	{
+		inline uint32_t floatBits(float f)
+		{
+			uint32_t b;
+			std::memcpy(&b, &f, sizeof(b));
+			return b;
+		}
+
+		inline float bitsFloat(uint32_t b)
+		{
+			float f;
+			std::memcpy(&f, &b, sizeof(f));
+			return f;
+		}
+
+		inline uint16_t floatToHalf(float f)
+		{
+#if LAME_VEC_F16C
+			return (uint16_t)_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+#else
+			const uint32_t b = floatBits(f);
+			const uint32_t sign = (b >> 16) & 0x8000;
+			const uint32_t a = b & 0x7fffffff;
+			uint32_t h;
+			if(a >= 0x47800000)
+			{
+				//too large for half, inf or NaN (quieted, the upper payload bits are kept)
+				h = a > 0x7f800000 ? 0x7e00 | ((a >> 13) & 0x3ff) : 0x7c00;
+			}
+			else if(a < 0x38800000)
+			{
+				//below 2^-14, adding 0.5 aligns the float significand to the denormal steps of 2^-24 and rounds
+				h = floatBits(bitsFloat(a) + 0.5f) - 0x3f000000;
+			}
+			else
+			{
+				//rebias the exponent and round to nearest even, a carry into the exponent gives inf at 65520
+				h = (a - 0x38000000 + 0xfff + ((a >> 13) & 1)) >> 13;
+			}
+			return (uint16_t)(h | sign);
+#endif
+		}
+
+		inline float halfToFloat(uint16_t h)
+		{
+#if LAME_VEC_F16C
+			return _cvtsh_ss(h);
+#else
+			const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+			const uint32_t e = (h >> 10) & 0x1f;
+			const uint32_t m = h & 0x3ff;
+			if(e == 31)
+			{
+				//NaN is quieted like the F16C conversion does
+				return bitsFloat(sign | 0x7f800000 | (m << 13) | (m ? 0x400000 : 0));
+			}
+			if(e == 0)
+			{
+				const float d = (float)m * (1.0f / 16777216);
+				return sign ? -d : d;
+			}
+			return bitsFloat(sign | ((e + 112) << 23) | (m << 13));
+#endif
+		}
+
+		//branch free so the bulk loops vectorize
+		inline uint16_t floatToBfloat16(float f)
+		{
+			const uint32_t b = floatBits(f);
+			const uint32_t rounded = (b + 0x7fff + ((b >> 16) & 1)) >> 16;
+			const uint32_t nan = (b >> 16) | 0x40;
+			return (uint16_t)((b & 0x7fffffff) > 0x7f800000 ? nan : rounded);
+		}
+
+		inline float bfloat16ToFloat(uint16_t h)
+		{
+			return bitsFloat((uint32_t)h << 16);
+		}
+
+#if LAME_VEC_SSE
+		//floatToBfloat16 of 4 floats, the arithmetic shift leaves the result sign extended so packs_epi32 does not saturate
+		inline __m128i bfloat16Round4(__m128 f)
+		{
+			const __m128i b = _mm_castps_si128(f);
+			const __m128i lsb = _mm_and_si128(_mm_srli_epi32(b, 16), _mm_set1_epi32(1));
+			const __m128i rounded = _mm_add_epi32(b, _mm_add_epi32(_mm_set1_epi32(0x7fff), lsb));
+			const __m128i isNan = _mm_cmpgt_epi32(_mm_and_si128(b, _mm_set1_epi32(0x7fffffff)), _mm_set1_epi32(0x7f800000));
+			const __m128i nan = _mm_or_si128(b, _mm_set1_epi32(0x400000));
+			return _mm_srai_epi32(_mm_or_si128(_mm_and_si128(isNan, nan), _mm_andnot_si128(isNan, rounded)), 16);
+		}
+#endif
+
+		//vec arrays as flat component arrays, false for padded vec types
+		template <size_t DIM, typename T>
+		constexpr bool isFlat()
+		{
+			return sizeof(vec<DIM, T>) == DIM * sizeof(T);
+		}
+	}
+
+	struct half
+	{
+		uint16_t bits;
+
+		half() = default;
+		explicit half(float f) : bits(detail::floatToHalf(f)) {}
+		operator float() const { return detail::halfToFloat(bits); }
+
+		static constexpr half fromBits(uint16_t b)
+		{
+			half h = half();
+			h.bits = b;
+			return h;
+		}
+	};
+
+	struct bfloat16
+	{
+		uint16_t bits;
+
+		bfloat16() = default;
+		explicit bfloat16(float f) : bits(detail::floatToBfloat16(f)) {}
+		operator float() const { return detail::bfloat16ToFloat(bits); }
+
+		static constexpr bfloat16 fromBits(uint16_t b)
+		{
+			bfloat16 h = bfloat16();
+			h.bits = b;
+			return h;
+		}
+	};
+
+	typedef vec<2, half> Vec2h;
+	typedef vec<3, half> Vec3h;
+	typedef vec<4, half> Vec4h;
+	typedef vec<2, bfloat16> Vec2bf;
+	typedef vec<3, bfloat16> Vec3bf;
+	typedef vec<4, bfloat16> Vec4bf;
+	typedef vec<2, uint16_t> Vec2q;
+	typedef vec<3, uint16_t> Vec3q;
+	typedef vec<4, uint16_t> Vec4q;
+
+	template <size_t DIM>
+	void convert(const vec<DIM, float>* in, vec<DIM, half>* out, size_t n)
+	{
+		static_assert(detail::isFlat<DIM, half>(), "vec<DIM, half> is expected to be an array of its components.");
+		if(!detail::isFlat<DIM, float>())
+		{
+			for(size_t i = 0; i < n; i++)
+			{
+				for(size_t d = 0; d < DIM; d++)
+				{
+					out[i][d] = half(in[i][d]);
+				}
+			}
+			return;
+		}
+		const float* src = n ? &in[0][0] : nullptr;
+		uint16_t* dst = n ? &out[0][0].bits : nullptr;
+		const size_t count = n * DIM;
+		size_t i = 0;
+#if LAME_VEC_F16C
+		for(; i + 8 <= count; i += 8)
+		{
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+		}
+#endif
+		for(; i < count; i++)
+		{
+			dst[i] = detail::floatToHalf(src[i]);
+		}
+	}
+
+	template <size_t DIM>
+	void convert(const vec<DIM, half>* in, vec<DIM, float>* out, size_t n)
+	{
+		static_assert(detail::isFlat<DIM, half>(), "vec<DIM, half> is expected to be an array of its components.");
+		if(!detail::isFlat<DIM, float>())
+		{
+			for(size_t i = 0; i < n; i++)
+			{
+				for(size_t d = 0; d < DIM; d++)
+				{
+					out[i][d] = in[i][d];
+				}
+			}
+			return;
+		}
+		const uint16_t* src = n ? &in[0][0].bits : nullptr;
+		float* dst = n ? &out[0][0] : nullptr;
+		const size_t count = n * DIM;
+		size_t i = 0;
+#if LAME_VEC_F16C
+		for(; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+		}
+#endif
+		for(; i < count; i++)
+		{
+			dst[i] = detail::halfToFloat(src[i]);
+		}
+	}
+
+	template <size_t DIM>
+	void convert(const vec<DIM, float>* in, vec<DIM, bfloat16>* out, size_t n)
+	{
+		static_assert(detail::isFlat<DIM, bfloat16>(), "vec<DIM, bfloat16> is expected to be an array of its components.");
+		if(!detail::isFlat<DIM, float>())
+		{
+			for(size_t i = 0; i < n; i++)
+			{
+				for(size_t d = 0; d < DIM; d++)
+				{
+					out[i][d] = bfloat16(in[i][d]);
+				}
+			}
+			return;
+		}
+		const float* src = n ? &in[0][0] : nullptr;
+		uint16_t* dst = n ? &out[0][0].bits : nullptr;
+		const size_t count = n * DIM;
+		size_t i = 0;
+#if LAME_VEC_SSE
+		for(; i + 8 <= count; i += 8)
+		{
+			const __m128i lo = detail::bfloat16Round4(_mm_loadu_ps(src + i));
+			const __m128i hi = detail::bfloat16Round4(_mm_loadu_ps(src + i + 4));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+		}
+#endif
+		for(; i < count; i++)
+		{
+			dst[i] = detail::floatToBfloat16(src[i]);
+		}
+	}
+
+	template <size_t DIM>
+	void convert(const vec<DIM, bfloat16>* in, vec<DIM, float>* out, size_t n)
+	{
+		static_assert(detail::isFlat<DIM, bfloat16>(), "vec<DIM, bfloat16> is expected to be an array of its components.");
+		if(!detail::isFlat<DIM, float>())
+		{
+			for(size_t i = 0; i < n; i++)
+			{
+				for(size_t d = 0; d < DIM; d++)
+				{
+					out[i][d] = in[i][d];
+				}
+			}
+			return;
+		}
+		const uint16_t* src = n ? &in[0][0].bits : nullptr;
+		float* dst = n ? &out[0][0] : nullptr;
+		const size_t count = n * DIM;
+		size_t i = 0;
+#if LAME_VEC_SSE
+		for(; i + 8 <= count; i += 8)
+		{
+			const __m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(_mm_setzero_si128(), h));
+			_mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(_mm_setzero_si128(), h));
+		}
+#endif
+		for(; i < count; i++)
+		{
+			dst[i] = detail::bfloat16ToFloat(src[i]);
+		}
+	}
+
+	template <size_t DIM>
+	std::vector<vec<DIM, half>> toHalf(const std::vector<vec<DIM, float>>& v)
+	{
+		std::vector<vec<DIM, half>> ret(v.size());
+		convert(v.data(), ret.data(), v.size());
+		return ret;
+	}
+
+	template <size_t DIM>
+	std::vector<vec<DIM, bfloat16>> toBfloat16(const std::vector<vec<DIM, float>>& v)
+	{
+		std::vector<vec<DIM, bfloat16>> ret(v.size());
+		convert(v.data(), ret.data(), v.size());
+		return ret;
+	}
+
+	template <size_t DIM>
+	std::vector<vec<DIM, float>> toFloat(const std::vector<vec<DIM, half>>& v)
+	{
+		std::vector<vec<DIM, float>> ret(v.size());
+		convert(v.data(), ret.data(), v.size());
+		return ret;
+	}
+
+	template <size_t DIM>
+	std::vector<vec<DIM, float>> toFloat(const std::vector<vec<DIM, bfloat16>>& v)
+	{
+		std::vector<vec<DIM, float>> ret(v.size());
+		convert(v.data(), ret.data(), v.size());
+		return ret;
+	}
+
+	template <size_t DIM>
+	class Quantizer
+	{
+		//per component parameters repeated over a block of points, so the bulk loops run over flat arrays
+		static constexpr size_t lanes = 8;
+		static constexpr size_t block = DIM * lanes;
+
+		float lo_[block];
+		float step_[block];
+		float inverse[block];
+
+	public:
+		Quantizer(const vec<DIM, float>& lo, const vec<DIM, float>& hi)
+		{
+			for(size_t k = 0; k < block; k++)
+			{
+				const size_t d = k % DIM;
+				assert(hi[d] >= lo[d]);
+				lo_[k] = lo[d];
+				step_[k] = (hi[d] - lo[d]) / 65535;
+				inverse[k] = hi[d] > lo[d] ? 65535 / (hi[d] - lo[d]) : 0;
+			}
+		}
+
+		vec<DIM, float> step() const
+		{
+			vec<DIM, float> ret;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				ret[d] = step_[d];
+			}
+			return ret;
+		}
+
+		vec<DIM, uint16_t> encode(const vec<DIM, float>& p) const
+		{
+			vec<DIM, uint16_t> ret;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				ret[d] = encode(p[d], d);
+			}
+			return ret;
+		}
+
+		vec<DIM, float> decode(const vec<DIM, uint16_t>& q) const
+		{
+			vec<DIM, float> ret;
+			for(size_t d = 0; d < DIM; d++)
+			{
+				ret[d] = decode(q[d], d);
+			}
+			return ret;
+		}
+
+		void encode(const vec<DIM, float>* in, vec<DIM, uint16_t>* out, size_t n) const
+		{
+			static_assert(detail::isFlat<DIM, uint16_t>(), "vec<DIM, uint16_t> is expected to be an array of its components.");
+			if(!detail::isFlat<DIM, float>())
+			{
+				for(size_t i = 0; i < n; i++)
+				{
+					out[i] = encode(in[i]);
+				}
+				return;
+			}
+			const float* src = n ? &in[0][0] : nullptr;
+			uint16_t* dst = n ? &out[0][0] : nullptr;
+			const size_t count = n * DIM;
+			size_t i = 0;
+			for(; i + block <= count; i += block)
+			{
+				for(size_t k = 0; k < block; k++)
+				{
+					dst[i + k] = encode(src[i + k], k);
+				}
+			}
+			for(size_t k = 0; i < count; i++, k++)
+			{
+				dst[i] = encode(src[i], k);
+			}
+		}
+
+		void decode(const vec<DIM, uint16_t>* in, vec<DIM, float>* out, size_t n) const
+		{
+			static_assert(detail::isFlat<DIM, uint16_t>(), "vec<DIM, uint16_t> is expected to be an array of its components.");
+			if(!detail::isFlat<DIM, float>())
+			{
+				for(size_t i = 0; i < n; i++)
+				{
+					out[i] = decode(in[i]);
+				}
+				return;
+			}
+			const uint16_t* src = n ? &in[0][0] : nullptr;
+			float* dst = n ? &out[0][0] : nullptr;
+			const size_t count = n * DIM;
+			size_t i = 0;
+			for(; i + block <= count; i += block)
+			{
+				for(size_t k = 0; k < block; k++)
+				{
+					dst[i + k] = decode(src[i + k], k);
+				}
+			}
+			for(size_t k = 0; i < count; i++, k++)
+			{
+				dst[i] = decode(src[i], k);
+			}
+		}
+
+	private:
+		//k is the position in the block, k % DIM the component
+		uint16_t encode(float v, size_t k) const
+		{
+			const float q = (v - lo_[k]) * inverse[k] + 0.5f;
+			return (uint16_t)(int32_t)std::min(std::max(0.0f, q), 65535.0f);
+		}
+
+		float decode(uint16_t q, size_t k) const
+		{
+			return lo_[k] + (float)q * step_[k];
+		}
+	};
+}
@@ -0,0 +1,370 @@
+#pragma once
+#include "vec.h"
+#include "../benchmark.h"
+
+/*
+SSE/AVX backed specializations of vec, included by vec.h.
+
+	vec<4, float>   - SSE, 16 byte aligned
+	vec<4, double>  - AVX, 32 byte aligned. Without AVX it computes with plain C++ but keeps the 32 byte alignment,
+	                  so the layout does not depend on -mavx.
+	vec<3, float>   - SSE, padded to 16 bytes with a zero w lane (opt-in, see below)
+
+The specializations have the same interface as the generic templates (constructors, operator[], x/y/z/w and the
+r/g/b/a, s/t/p/q aliases, norm, sqrnorm, normalize) and all free operators keep working. Added kernels: dot, cross
+(vec<3, float>), vmin, vmax, fmadd and fastNormalize, which also have generic versions in vec.h. fastNormalize of the
+float specializations uses _mm_rsqrt_ps with one Newton step for all lanes, see rsqrt in vec.h for the error.
+
+Flags, to be defined before including vec.h:
+	#define LAME_VEC_DISABLE_SIMD 1 - always use the generic scalar templates
+	#define LAME_VEC_SIMD_VEC3 1    - use the padded SIMD vec<3, float>. This changes sizeof(Vec3f) from 12 to 16,
+	                                  so it is opt-in for code that keeps large Vec3f arrays or relies on the layout.
+The specializations are only available if the compiler targets the instruction set (eg. -mavx / /arch:AVX) and
+require the anonymous structs (LAME_VEC_DISABLE_ANON_STRUCT disables them).
+
+Results can differ from the generic templates in the last bit, the horizontal sums are added pairwise.
+In constant expressions the specializations compute with plain C++ (like the generic templates), this needs
+std::is_constant_evaluated or __builtin_is_constant_evaluated (GCC 9, Clang 9, MSVC 2019 16.5).
+
+void benchmarkVecSimd(size_t ops = 100000000)
+Runs ops of each operation below on arrays of 4096 vectors and prints the times with BenchTimer.
+Build it once more with LAME_VEC_DISABLE_SIMD for the generic numbers.
+
+Timings of benchmarkVecSimd(), single core, -O2 -mavx2 -mfma, generic template vs specialization:
+	Vec4f a + b          ~26 ms vs ~27 ms (the generic loop is auto vectorized as well)
+	Vec4f a * b          ~48 ms vs ~48 ms (same)
+	Vec4f normalize      ~180 ms vs ~180 ms (bound by the square root and the division)
+	Vec4f fastNormalize  ~185 ms vs ~105 ms
+	Vec3f cross          ~55 ms vs ~60 ms (padded, LAME_VEC_SIMD_VEC3)
+	Vec4d a + b          ~44 ms vs ~28 ms
+*/
+
+#if !defined(LAME_VEC_DISABLE_SIMD) && !LAME_VEC_DISABLE_ANON_STRUCT
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAME_VEC_SSE 1
+#include <immintrin.h>
+#endif
+#if defined(__AVX__)
+#define LAME_VEC_AVX 1
+#endif
+#endif
+
+#if LAME_VEC_SSE
+namespace lameutil
+{
+	namespace detail
+	{
+		//a . b in every lane
+		inline __m128 dot4(__m128 a, __m128 b)
+		{
+			__m128 p = _mm_mul_ps(a, b);
+			p = _mm_add_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1)));
+			return _mm_add_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 0, 3, 2)));
+		}
+
+		inline __m128 fmadd4(__m128 a, __m128 b, __m128 c)
+		{
+#if defined(__FMA__)
+			return _mm_fmadd_ps(a, b, c);
+#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+		}
+
+		//hardware estimate (relative error < 1.5 * 2^-12) refined by one Newton step y * (1.5 - 0.5 * x * y * y)
+		inline __m128 rsqrt4(__m128 x)
+		{
+			const __m128 y = _mm_rsqrt_ps(x);
+			const __m128 h = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(y, y));
+			return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), h));
+		}
+
+#if LAME_VEC_AVX
+		inline double hsum4(__m256d v)
+		{
+			__m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+			return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+		}
+
+		inline __m256d fmadd4(__m256d a, __m256d b, __m256d c)
+		{
+#if defined(__FMA__)
+			return _mm256_fmadd_pd(a, b, c);
+#else
+			return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+		}
+#endif
+	}
+
+	template <>
+	struct alignas(16) vec<4, float>
+	{
+		//the constructors initialize the float members so the vectors can be built in constant expressions
+		constexpr vec() : x(), y(), z(), w() {}
+		constexpr vec(float X, float Y, float Z, float W) : x(X), y(Y), z(Z), w(W) {}
+		explicit vec(__m128 v) : m(v) {}
+		constexpr float& operator[](const size_t i) { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr const float& operator[](const size_t i) const { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		LAME_VEC_SIMD_CONSTEXPR VecReal<float> norm() const { return detail::sqrt(sqrnorm()); }
+		LAME_VEC_SIMD_CONSTEXPR inline VecReal<float> sqrnorm() const { return LAME_VEC_CONSTANT_EVALUATED() ? x * x + y * y + z * z + w * w : _mm_cvtss_f32(detail::dot4(m, m)); }
+		LAME_VEC_SIMD_CONSTEXPR inline vec<4, float>& normalize()
+		{
+			if(LAME_VEC_CONSTANT_EVALUATED())
+			{
+				return *this = *this * (1 / norm());
+			}
+			m = _mm_div_ps(m, _mm_sqrt_ps(detail::dot4(m, m)));
+			return *this;
+		}
+
+		union
+		{
+			__m128 m;
+			struct { float x, y, z, w; };
+			struct { float r, g, b, a; };
+			struct { float s, t, p, q; };
+		};
+	};
+
+	LAME_VEC_SIMD_CONSTEXPR float operator*(const vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, float>(lhs, rhs); return _mm_cvtss_f32(detail::dot4(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator+(const vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+<4, float>(lhs, rhs); return vec<4, float>(_mm_add_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator-(const vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-<4, float>(lhs, rhs); return vec<4, float>(_mm_sub_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float>& operator+=(vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+=<4, float>(lhs, rhs); lhs.m = _mm_add_ps(lhs.m, rhs.m); return lhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float>& operator-=(vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-=<4, float>(lhs, rhs); lhs.m = _mm_sub_ps(lhs.m, rhs.m); return lhs; }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator*(const vec<4, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, float>(v, scalar); return vec<4, float>(_mm_mul_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator*(const U& scalar, const vec<4, float>& v) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, float>(scalar, v); return vec<4, float>(_mm_mul_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator*=(vec<4, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*=<4, float>(v, scalar); v.m = _mm_mul_ps(v.m, _mm_set1_ps((float)scalar)); return v; }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator/(const vec<4, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/<4, float>(v, scalar); return vec<4, float>(_mm_div_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> operator/=(vec<4, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/=<4, float>(v, scalar); v.m = _mm_div_ps(v.m, _mm_set1_ps((float)scalar)); return v; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator==(const vec<4, float>& v, const vec<4, float>& u) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator==<4, float>(v, u); return _mm_movemask_ps(_mm_cmpeq_ps(v.m, u.m)) == 0xf; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator!=(const vec<4, float>& v, const vec<4, float>& u) { return !(v == u); }
+	LAME_VEC_SIMD_CONSTEXPR float dot(const vec<4, float>& lhs, const vec<4, float>& rhs) { return lhs * rhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> vmin(const vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmin<4, float>(lhs, rhs); return vec<4, float>(_mm_min_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> vmax(const vec<4, float>& lhs, const vec<4, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmax<4, float>(lhs, rhs); return vec<4, float>(_mm_max_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> fmadd(const vec<4, float>& a, const vec<4, float>& b, const vec<4, float>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<4, float>(a, b, c); return vec<4, float>(detail::fmadd4(a.m, b.m, c.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, float> fmadd(const vec<4, float>& a, const float& s, const vec<4, float>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<4, float>(a, s, c); return vec<4, float>(detail::fmadd4(a.m, _mm_set1_ps(s), c.m)); }
+	inline vec<4, float> fastNormalize(const vec<4, float>& v) { return vec<4, float>(_mm_mul_ps(v.m, detail::rsqrt4(detail::dot4(v.m, v.m)))); }
+
+#if LAME_VEC_SIMD_VEC3
+	template <>
+	struct alignas(16) vec<3, float>
+	{
+		constexpr vec() : x(), y(), z(), w_() {}
+		constexpr vec(float X, float Y, float Z) : x(X), y(Y), z(Z), w_() {}
+		explicit vec(__m128 v) : m(v) {}
+		constexpr float& operator[](const size_t i) { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
+		constexpr const float& operator[](const size_t i) const { assert(i < 3); return i <= 0 ? x : (1 == i ? y : z); }
+		LAME_VEC_SIMD_CONSTEXPR inline VecReal<float> norm() const { return detail::sqrt(sqrnorm()); }
+		LAME_VEC_SIMD_CONSTEXPR inline VecReal<float> sqrnorm() const { return LAME_VEC_CONSTANT_EVALUATED() ? x * x + y * y + z * z : _mm_cvtss_f32(detail::dot4(m, m)); }
+		LAME_VEC_SIMD_CONSTEXPR inline vec<3, float>& normalize()
+		{
+			if(LAME_VEC_CONSTANT_EVALUATED())
+			{
+				return *this = *this * (1 / norm());
+			}
+			m = _mm_div_ps(m, _mm_sqrt_ps(detail::dot4(m, m)));
+			return *this;
+		}
+
+		//the w lane is kept at zero by every operation, dot products can use all four lanes
+		union
+		{
+			__m128 m;
+			struct { float x, y, z, w_; };
+			struct { float r, g, b; };
+			struct { float s, t, p; };
+		};
+	};
+
+	LAME_VEC_SIMD_CONSTEXPR float operator*(const vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<3, float>(lhs, rhs); return _mm_cvtss_f32(detail::dot4(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator+(const vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+<3, float>(lhs, rhs); return vec<3, float>(_mm_add_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator-(const vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-<3, float>(lhs, rhs); return vec<3, float>(_mm_sub_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float>& operator+=(vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+=<3, float>(lhs, rhs); lhs.m = _mm_add_ps(lhs.m, rhs.m); return lhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float>& operator-=(vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-=<3, float>(lhs, rhs); lhs.m = _mm_sub_ps(lhs.m, rhs.m); return lhs; }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator*(const vec<3, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<3, float>(v, scalar); return vec<3, float>(_mm_mul_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator*(const U& scalar, const vec<3, float>& v) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<3, float>(scalar, v); return vec<3, float>(_mm_mul_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator*=(vec<3, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*=<3, float>(v, scalar); v.m = _mm_mul_ps(v.m, _mm_set1_ps((float)scalar)); return v; }
+	//0 / s keeps the w lane at zero
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator/(const vec<3, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/<3, float>(v, scalar); return vec<3, float>(_mm_div_ps(v.m, _mm_set1_ps((float)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> operator/=(vec<3, float>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/=<3, float>(v, scalar); v.m = _mm_div_ps(v.m, _mm_set1_ps((float)scalar)); return v; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator==(const vec<3, float>& v, const vec<3, float>& u) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator==<3, float>(v, u); return (_mm_movemask_ps(_mm_cmpeq_ps(v.m, u.m)) & 0x7) == 0x7; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator!=(const vec<3, float>& v, const vec<3, float>& u) { return !(v == u); }
+	LAME_VEC_SIMD_CONSTEXPR float dot(const vec<3, float>& lhs, const vec<3, float>& rhs) { return lhs * rhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> vmin(const vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmin<3, float>(lhs, rhs); return vec<3, float>(_mm_min_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> vmax(const vec<3, float>& lhs, const vec<3, float>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmax<3, float>(lhs, rhs); return vec<3, float>(_mm_max_ps(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> fmadd(const vec<3, float>& a, const vec<3, float>& b, const vec<3, float>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<3, float>(a, b, c); return vec<3, float>(detail::fmadd4(a.m, b.m, c.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> fmadd(const vec<3, float>& a, const float& s, const vec<3, float>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<3, float>(a, s, c); return vec<3, float>(detail::fmadd4(a.m, _mm_set1_ps(s), c.m)); }
+	inline vec<3, float> fastNormalize(const vec<3, float>& v) { return vec<3, float>(_mm_mul_ps(v.m, detail::rsqrt4(detail::dot4(v.m, v.m)))); }
+
+	LAME_VEC_SIMD_CONSTEXPR vec<3, float> cross(const vec<3, float>& v1, const vec<3, float>& v2)
+	{
+		if(LAME_VEC_CONSTANT_EVALUATED())
+		{
+			return lameutil::cross<float>(v1, v2);
+		}
+		const __m128 a = _mm_shuffle_ps(v1.m, v1.m, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 b = _mm_shuffle_ps(v2.m, v2.m, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(v1.m, b), _mm_mul_ps(a, v2.m));
+		return vec<3, float>(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+	}
+#endif
+
+#if LAME_VEC_AVX
+	template <>
+	struct alignas(32) vec<4, double>
+	{
+		constexpr vec() : x(), y(), z(), w() {}
+		constexpr vec(double X, double Y, double Z, double W) : x(X), y(Y), z(Z), w(W) {}
+		explicit vec(__m256d v) : m(v) {}
+		constexpr double& operator[](const size_t i) { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr const double& operator[](const size_t i) const { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		LAME_VEC_SIMD_CONSTEXPR double norm() const { return detail::sqrt(sqrnorm()); }
+		LAME_VEC_SIMD_CONSTEXPR inline double sqrnorm() const { return LAME_VEC_CONSTANT_EVALUATED() ? x * x + y * y + z * z + w * w : detail::hsum4(_mm256_mul_pd(m, m)); }
+		LAME_VEC_SIMD_CONSTEXPR inline vec<4, double>& normalize()
+		{
+			if(LAME_VEC_CONSTANT_EVALUATED())
+			{
+				return *this = *this * (1 / norm());
+			}
+			m = _mm256_mul_pd(m, _mm256_set1_pd(1 / norm()));
+			return *this;
+		}
+
+		union
+		{
+			__m256d m;
+			struct { double x, y, z, w; };
+			struct { double r, g, b, a; };
+			struct { double s, t, p, q; };
+		};
+	};
+
+	LAME_VEC_SIMD_CONSTEXPR double operator*(const vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, double>(lhs, rhs); return detail::hsum4(_mm256_mul_pd(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator+(const vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+<4, double>(lhs, rhs); return vec<4, double>(_mm256_add_pd(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator-(const vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-<4, double>(lhs, rhs); return vec<4, double>(_mm256_sub_pd(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double>& operator+=(vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator+=<4, double>(lhs, rhs); lhs.m = _mm256_add_pd(lhs.m, rhs.m); return lhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double>& operator-=(vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator-=<4, double>(lhs, rhs); lhs.m = _mm256_sub_pd(lhs.m, rhs.m); return lhs; }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator*(const vec<4, double>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, double>(v, scalar); return vec<4, double>(_mm256_mul_pd(v.m, _mm256_set1_pd((double)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator*(const U& scalar, const vec<4, double>& v) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*<4, double>(scalar, v); return vec<4, double>(_mm256_mul_pd(v.m, _mm256_set1_pd((double)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator*=(vec<4, double>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator*=<4, double>(v, scalar); v.m = _mm256_mul_pd(v.m, _mm256_set1_pd((double)scalar)); return v; }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator/(const vec<4, double>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/<4, double>(v, scalar); return vec<4, double>(_mm256_div_pd(v.m, _mm256_set1_pd((double)scalar))); }
+	template <typename U, typename = typename std::enable_if<std::is_arithmetic<U>::value>::type>
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> operator/=(vec<4, double>& v, const U& scalar) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator/=<4, double>(v, scalar); v.m = _mm256_div_pd(v.m, _mm256_set1_pd((double)scalar)); return v; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator==(const vec<4, double>& v, const vec<4, double>& u) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::operator==<4, double>(v, u); return _mm256_movemask_pd(_mm256_cmp_pd(v.m, u.m, _CMP_EQ_OQ)) == 0xf; }
+	LAME_VEC_SIMD_CONSTEXPR bool operator!=(const vec<4, double>& v, const vec<4, double>& u) { return !(v == u); }
+	LAME_VEC_SIMD_CONSTEXPR double dot(const vec<4, double>& lhs, const vec<4, double>& rhs) { return lhs * rhs; }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> vmin(const vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmin<4, double>(lhs, rhs); return vec<4, double>(_mm256_min_pd(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> vmax(const vec<4, double>& lhs, const vec<4, double>& rhs) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::vmax<4, double>(lhs, rhs); return vec<4, double>(_mm256_max_pd(lhs.m, rhs.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> fmadd(const vec<4, double>& a, const vec<4, double>& b, const vec<4, double>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<4, double>(a, b, c); return vec<4, double>(detail::fmadd4(a.m, b.m, c.m)); }
+	LAME_VEC_SIMD_CONSTEXPR vec<4, double> fmadd(const vec<4, double>& a, const double& s, const vec<4, double>& c) { if(LAME_VEC_CONSTANT_EVALUATED()) return lameutil::fmadd<4, double>(a, s, c); return vec<4, double>(detail::fmadd4(a.m, _mm256_set1_pd(s), c.m)); }
+#else
+	//same size and alignment as the AVX version, translation units built with and without -mavx can share Vec4d data
+	template <>
+	struct alignas(32) vec<4, double>
+	{
+		constexpr vec() : x(), y(), z(), w() {}
+		constexpr vec(double X, double Y, double Z, double W) : x(X), y(Y), z(Z), w(W) {}
+		constexpr double& operator[](const size_t i) { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr const double& operator[](const size_t i) const { assert(i < 4); return i <= 0 ? x : (1 == i ? y : (2 == i ? z : w)); }
+		constexpr double norm() const { return detail::sqrt(sqrnorm()); }
+		constexpr inline double sqrnorm() const { return x * x + y * y + z * z + w * w; }
+		constexpr inline vec<4, double>& normalize() { *this = (*this) * (1 / norm()); return *this; }
+
+		union
+		{
+			struct { double x, y, z, w; };
+			struct { double r, g, b, a; };
+			struct { double s, t, p, q; };
+		};
+	};
+#endif
+}
+#endif
+
+namespace lameutil
+{
+	//the generic version is defined at the end of vec.h
+	template <size_t DIM, typename T>
+	inline vec<DIM, T> fastNormalize(const vec<DIM, T>& v);
+
+	inline void benchmarkVecSimd(size_t ops = 100000000)
+	{
+		const size_t n = 4096, passes = ops / n;
+		std::vector<Vec4f> a(n), b(n), c(n);
+		std::vector<Vec3f> a3(n), b3(n), c3(n);
+		std::vector<Vec4d> ad(n), cd(n);
+		std::vector<float> dots(n);
+		for(size_t i = 0; i < n; i++)
+		{
+			const float f = (float)i / n;
+			a[i] = Vec4f(f, 1 - f, 0.5f, -f);
+			b[i] = Vec4f(-f, f, 1, 0.25f);
+			c[i] = Vec4f(1, 0, 0, 0);
+			a3[i] = Vec3f(f, 1 - f, 0.5f);
+			b3[i] = Vec3f(1, f, -f);
+			ad[i] = Vec4d(f, 1 - f, 0.5, -f);
+		}
+
+		//every pass depends on the previous one, so the passes cannot be folded
+		{
+			BenchTimer timer("Vec4f a + b");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+					c[i] = c[i] + a[i];
+		}
+		{
+			BenchTimer timer("Vec4f a * b");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+					dots[i] += a[i] * b[i];
+		}
+		{
+			BenchTimer timer("Vec4f normalize");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+				{
+					Vec4f v = a[i] + c[i];
+					c[i] = v.normalize();
+				}
+		}
+		{
+			BenchTimer timer("Vec4f fastNormalize");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+					c[i] = fastNormalize(a[i] + c[i]);
+		}
+		{
+			BenchTimer timer("Vec3f cross");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+					c3[i] = c3[i] + cross(a3[i], b3[i]);
+		}
+		{
+			BenchTimer timer("Vec4d a + b");
+			for(size_t p = 0; p < passes; p++)
+				for(size_t i = 0; i < n; i++)
+					cd[i] = cd[i] + ad[i];
+		}
+
+		volatile double sink = 0;
+		for(size_t i = 0; i < n; i++)
+		{
+			sink = sink + c[i].x + c3[i].x + cd[i].x + dots[i];
+		}
+	}
+}
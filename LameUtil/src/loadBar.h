@@ -1,6 +1,25 @@
 ﻿#pragma once
 #include <iostream>
-#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#include <stdio.h>
+#else
+#include <unistd.h>
+#endif
 
 /*
 The class must be initialized before the for loop with the loop iterator and the limiting variable of the loop.
@@ -15,8 +34,14 @@ LoadingBar(int& iter, int& limit, const char* sign = "<")
 void setBarSize(const int size) 
 Resizes the loading bar
 
+void setMinInterval(std::chrono::milliseconds interval)
+Minimal time between two redraws (default 50ms), the final state is always drawn
+
 void bar()
-Must be appended to the end of the for loop
+Must be appended to the end of the for loop.
+Costs a single compare on most iterations, the bar is only redrawn once the visible percentage can change
+and at most once per interval, with one write to the standard output.
+Next to the count and the percentage the bar shows the smoothed throughput (items/s) and the ETA.
 
 
 Example:
@@ -30,44 +55,424 @@ for(;i <= lim; i++){
 	bar.bar();
 }
 
+
+progress(range) and progress(n) wrap a loop into a range adapter, no manual bar() call is needed and the
+counts are 64 bit. Any forward range works (containers, arrays, custom ranges), progress(n) iterates the
+integers [0, n> of the type of n. The iterator only adds an increment and a compare against a cached check
+position to the loop, the bar itself is a ProgressBar which can also be driven by hand.
+
+ProgressRange progress(Range&& range, int barSize = 20)
+ProgressRange progress(T n, int barSize = 20)
+
+ProgressBar(long long total, int barSize = 20)
+long long update(long long current) - draws if due and returns the position of the next check
+void finish(long long current) - draws the final state, called by the destructor of the adapters
+
+
+Example:
+
+for(auto&& item : progress(items))
+	process(item);
+
+for(int64_t i : progress(int64_t(1) << 33))
+	...
+
+
+ConcurrentLoadingBar is meant for parallel loops (OpenMP, thread pools, ...). Workers only bump a counter
+sharded per thread, a single background thread sums the shards and redraws the bar, so the output never
+interleaves and the workers never touch the stream.
+
+ConcurrentLoadingBar(long long total, int barSize = 20, std::chrono::milliseconds interval = 100ms)
+	total - number of work items
+	barSize - (optional) length of the loading bar
+	interval - (optional) time between redraws
+
+void tick(long long n = 1, long long bytes = 0)
+Reports n finished items (and optionally the bytes they processed), safe to call from any thread.
+
+void finish()
+Stops the renderer thread and draws the final state. Called by the destructor.
+
+
+Example:
+
+ConcurrentLoadingBar bar(n);
+#pragma omp parallel for
+for(int i = 0; i < n; i++){
+	...
+	bar.tick();
+}
+
+
+MultiLoadingBar renders several stacked bars, for nested loops or concurrent pipeline stages. On a terminal the bars
+are redrawn in place with ANSI cursor control (Windows 10+ consoles need virtual terminal processing enabled).
+When the standard output is not a terminal (batch logs, CI) it prints one log line per unfinished task every
+logInterval instead, and one line when a task finishes.
+
+MultiLoadingBar(Mode mode = Mode::AUTO, int barSize = 20, std::chrono::milliseconds interval = 100ms, std::chrono::seconds logInterval = 10s)
+	mode - AUTO picks TTY or LOG depending on the standard output
+
+MultiLoadingBar::Task& add(const std::string& label, long long total)
+Adds a bar, the reference stays valid for the lifetime of the manager.
+
+void Task::tick(long long n = 1, long long bytes = 0)
+void Task::reset(long long total)
+void Task::finish()
+Progress reporting of a single bar, safe to call from any thread. Ticks concurrent with reset() may be counted on either side of it.
+
+
+Throughput is an exponentially weighted moving average with a time constant of a few seconds, so the ETA
+follows changes of speed without jumping around on every redraw.
+
+
+Example:
+
+MultiLoadingBar bars;
+MultiLoadingBar::Task& files = bars.add("files", fileCount);
+MultiLoadingBar::Task& bytes = bars.add("current", 0);
+for(const File& f : files){
+	bytes.reset(f.size);
+	...
+	bytes.tick(1, chunkSize);
+	...
+	files.tick();
+}
+--------------------
+files   |#######-------------| 35/100 35% 2.1 it/s ETA 00:31
+current |###############-----| 3/4 75% 1.5 it/s 96.2 MB/s ETA 00:01
+
 */
 
 namespace lameutil
 {
 
+	namespace detail
+	{
+		//exponentially weighted moving average of the item and byte throughput
+		class RateEstimator
+		{
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+			void sample(long long done, long long bytes, Clock::time_point now)
+			{
+				if(!started)
+				{
+					started = true;
+					lastDone = done;
+					lastBytes = bytes;
+					lastTime = now;
+					return;
+				}
+				const double dt = std::chrono::duration<double>(now - lastTime).count();
+				if(dt <= 0)
+				{
+					return;
+				}
+				const double itemRate = (done - lastDone) / dt;
+				const double byteRate = (bytes - lastBytes) / dt;
+				if(!primed)
+				{
+					primed = true;
+					items = itemRate;
+					bytesRate = byteRate;
+				}
+				else
+				{
+					const double alpha = 1 - std::exp(-dt / TIME_CONSTANT);
+					items += alpha * (itemRate - items);
+					bytesRate += alpha * (byteRate - bytesRate);
+				}
+				lastDone = done;
+				lastBytes = bytes;
+				lastTime = now;
+			}
+
+			void reset()
+			{
+				started = primed = false;
+				items = bytesRate = 0;
+			}
+
+			bool valid() const { return primed; }
+			double itemsPerSecond() const { return items; }
+			double bytesPerSecond() const { return bytesRate; }
+
+			//remaining seconds, negative when unknown
+			double eta(long long done, long long total) const
+			{
+				if(!primed || items <= 0 || total <= 0)
+				{
+					return -1;
+				}
+				return done >= total ? 0 : (total - done) / items;
+			}
+
+		private:
+			static constexpr double TIME_CONSTANT = 3.0;
+
+			bool started = false, primed = false;
+			long long lastDone = 0, lastBytes = 0;
+			Clock::time_point lastTime;
+			double items = 0, bytesRate = 0;
+		};
+
+		//counter sharded per thread, adding is a relaxed fetch_add on a cache line that is rarely shared
+		class ShardedCounter
+		{
+		public:
+			void add(long long n)
+			{
+				shards[slot()].count.fetch_add(n, std::memory_order_relaxed);
+			}
+
+			long long sum() const
+			{
+				long long ret = 0;
+				for(const Shard& s : shards)
+				{
+					ret += s.count.load(std::memory_order_relaxed);
+				}
+				return ret;
+			}
+
+			void reset()
+			{
+				for(Shard& s : shards)
+				{
+					s.count.store(0, std::memory_order_relaxed);
+				}
+			}
+
+		private:
+			static constexpr size_t SHARDS = 64;
+
+			struct alignas(64) Shard
+			{
+				std::atomic<long long> count{0};
+			};
+
+			Shard shards[SHARDS];
+
+			//every thread keeps its shard for the lifetime of the thread
+			static size_t slot()
+			{
+				static std::atomic<size_t> nextSlot{0};
+				thread_local size_t s = nextSlot++ % SHARDS;
+				return s;
+			}
+		};
+
+		//" 12.3k it/s" or, with joinUnit, " 96.2 MB/s"
+		inline void appendScaled(std::string& line, double value, const char* unit, bool joinUnit = false)
+		{
+			static const char* prefixes[] = {"", "k", "M", "G", "T"};
+			int p = 0;
+			for(; value >= 1000 && p < 4; p++)
+			{
+				value /= 1000;
+			}
+			char buffer[32];
+			if(joinUnit)
+				std::snprintf(buffer, sizeof(buffer), " %.3g %s%s", value, prefixes[p], unit);
+			else
+				std::snprintf(buffer, sizeof(buffer), " %.3g%s %s", value, prefixes[p], unit);
+			line += buffer;
+		}
+
+		inline void appendDuration(std::string& line, double seconds)
+		{
+			char buffer[32];
+			const long long s = (long long)(seconds + 0.5);
+			if(s >= 3600)
+				std::snprintf(buffer, sizeof(buffer), "%lld:%02lld:%02lld", s / 3600, (s / 60) % 60, s % 60);
+			else
+				std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld", s / 60, s % 60);
+			line += buffer;
+		}
+
+		//appends "|####------| done/total percentage%" and, if a rate is given, the throughput and the ETA
+		inline void formatBar(std::string& line, long long done, long long total, int barSize, const RateEstimator* rate = nullptr, bool showBytes = false)
+		{
+			const double percentage = total > 0 ? (double)done / total : 1.0;
+			int completed = (int)(barSize * percentage);
+			completed = completed < 0 ? 0 : (completed > barSize ? barSize : completed);
+
+			line += '|';
+			line.append(completed, '#');
+			line.append(barSize - completed, '-');
+			char tail[64];
+			std::snprintf(tail, sizeof(tail), "| %lld/%lld %.3g%%", done, total, percentage * 100);
+			line += tail;
+
+			if(rate && rate->valid())
+			{
+				appendScaled(line, rate->itemsPerSecond(), "it/s");
+				if(showBytes)
+				{
+					appendScaled(line, rate->bytesPerSecond(), "B/s", true);
+				}
+				const double eta = rate->eta(done, total);
+				if(eta >= 0)
+				{
+					line += " ETA ";
+					appendDuration(line, eta);
+				}
+			}
+		}
+
+		template <typename R, typename = void>
+		struct HasSize : std::false_type {};
+		template <typename R>
+		struct HasSize<R, decltype((void)std::declval<R&>().size())> : std::true_type {};
+
+		inline bool isTerminal(FILE* stream)
+		{
+#ifdef _WIN32
+			return _isatty(_fileno(stream)) != 0;
+#else
+			return isatty(fileno(stream)) != 0;
+#endif
+		}
+	}
+
+	class ProgressBar
+	{
+	public:
+		ProgressBar() = delete;
+		ProgressBar(const ProgressBar& oth) = delete;
+
+		explicit ProgressBar(long long total, int barSize = 20) : total(total), barSize(barSize)
+		{
+			//0.1% is the finest change the percentage shows
+			visibleStep = total / 1000 > 1 ? total / 1000 : 1;
+			lastCheck = Clock::now();
+		}
+		~ProgressBar()
+		{
+			if(!finished)
+			{
+				std::cout << std::endl;
+			}
+		}
+
+		void setBarSize(const int size)
+		{
+			barSize = size;
+		}
+
+		void setMinInterval(const std::chrono::milliseconds interval)
+		{
+			minInterval = interval;
+		}
+
+		long long size() const
+		{
+			return total;
+		}
+
+		//draws the bar if it is due and returns the position of the next check
+		long long update(long long current)
+		{
+			const Clock::time_point now = Clock::now();
+			rate.sample(current, 0, now);
+			if(current >= total || drawn < 0 || now - lastDraw >= minInterval)
+			{
+				draw(current);
+				lastDraw = now;
+			}
+
+			//check again after one visible step, or sooner if the loop is so slow that the interval passes first
+			long long step = visibleStep;
+			const long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastCheck).count();
+			if(elapsed > 0 && current > lastCheckIter)
+			{
+				const long long perInterval = (current - lastCheckIter) * std::chrono::duration_cast<std::chrono::microseconds>(minInterval).count() / elapsed;
+				step = perInterval < step ? perInterval : step;
+			}
+			lastCheckIter = current;
+			lastCheck = now;
+
+			const long long next = current + (step > 1 ? step : 1);
+			return current < total && next > total ? total : next;
+		}
+
+		//draws the final state (if it was not drawn yet) and ends the line
+		void finish(long long current)
+		{
+			if(finished)
+				return;
+			if(current != drawn)
+			{
+				draw(current);
+			}
+			std::cout << std::endl;
+			finished = true;
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		long long total;
+		int barSize;
+		long long drawn = -1;
+		bool finished = false;
+
+		long long visibleStep = 1;
+		long long lastCheckIter = 0;
+		Clock::time_point lastCheck;
+		Clock::time_point lastDraw;
+		std::chrono::milliseconds minInterval = std::chrono::milliseconds(50);
+
+		std::string line;
+		detail::RateEstimator rate;
+
+		void draw(long long current)
+		{
+			drawn = current;
+			line = "\r";
+			detail::formatBar(line, current, total, barSize, &rate);
+			line += "    ";
+			std::cout.write(line.data(), line.size());
+			std::cout.flush();
+		}
+	};
+
 	class LoadingBar
 	{
 	public:
 		LoadingBar() = delete;
 		LoadingBar(const LoadingBar& oth) = delete;
 
-		LoadingBar(int& iter, int& limit, const char* sign = "<") : pIter(&iter), limit(limit)
+		LoadingBar(int& iter, int& limit, const char* sign = "<") : pIter(&iter), sign(parse(sign)), progress(init(iter, limit, this->sign))
 		{
-			parse(sign);
-			init();
 		}
 		~LoadingBar()
 		{
-			std::cout << std::endl;
+			//the loop may have ended early or stopped between two redraws
+			long long current = position();
+			const long long limit = progress.size();
+			progress.finish(current < 0 ? 0 : (current > limit ? limit : current));
 		}
 
 		void setBarSize(const int size)
 		{
-			barSize = size;
+			progress.setBarSize(size);
+		}
+
+		void setMinInterval(const std::chrono::milliseconds interval)
+		{
+			progress.setMinInterval(interval);
 		}
 
 		void bar()
 		{
-			if(sign < 2)
+			const long long current = position();
+			if(current < nextCheck)
 			{
-				iter = (float)*pIter;
+				return;
 			}
-			else
-			{
-				iter = (float)(limit - *pIter);
-			}
-
-			print();
+			nextCheck = progress.update(current);
 		}
 	private:
 		enum Sign : int
@@ -76,37 +481,36 @@ namespace lameutil
 		};
 
 		int* pIter;
-		float iter;
-		int limit;
+		Sign sign;
+		ProgressBar progress;
 
-		int barSize = 20;
+		//the fast path of bar() only compares against nextCheck
+		long long nextCheck = 0;
 
-		Sign sign = Sign::LESS;
 
-
-		void parse(const char* str)
+		static Sign parse(const char* str)
 		{
 			if(str[0] == '<')
 			{
 				if(str[1] != '\0')
-					sign = Sign::LESSEQ;
+					return Sign::LESSEQ;
 				else
-					sign = Sign::LESS;
+					return Sign::LESS;
 			}
 			else
 			{
 				if(str[1] != '\0')
-					sign = Sign::MOREEQ;
+					return Sign::MOREEQ;
 				else
-					sign = Sign::MORE;
+					return Sign::MORE;
 			}
 		}
 
-		void init()
+		static int init(int iter, int limit, Sign sign)
 		{
 			if(sign > 1)
 			{
-				limit = *pIter - limit;
+				limit = iter - limit;
 				limit++;
 			}
 
@@ -114,26 +518,459 @@ namespace lameutil
 			{
 				limit--;
 			}
+			return limit;
+		}
+
+		long long position() const
+		{
+			return sign < 2 ? (long long)*pIter : progress.size() - *pIter;
+		}
+
+	};
+
+	template <typename T>
+	class CountingRange
+	{
+	public:
+		class iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const T* pointer;
+			typedef T reference;
+
+			iterator() = default;
+			explicit iterator(T v) : v(v) {}
+
+			T operator*() const { return v; }
+			iterator& operator++() { ++v; return *this; }
+			iterator operator++(int) { iterator ret = *this; ++v; return ret; }
+			bool operator==(const iterator& oth) const { return v == oth.v; }
+			bool operator!=(const iterator& oth) const { return v != oth.v; }
+
+		private:
+			T v = T();
+		};
+
+		explicit CountingRange(T n) : n(n < T() ? T() : n) {}
+
+		iterator begin() const { return iterator(T()); }
+		iterator end() const { return iterator(n); }
+		size_t size() const { return (size_t)n; }
+
+	private:
+		T n;
+	};
+
+	template <typename Range>
+	class ProgressRange
+	{
+	private:
+		typedef decltype(std::begin(std::declval<Range&>())) BaseIterator;
+		typedef decltype(std::end(std::declval<Range&>())) BaseSentinel;
+
+		Range range;
+		ProgressBar bar;
+		long long last = 0;
+
+		template <typename R>
+		static long long length(R& r)
+		{
+			if constexpr(detail::HasSize<R>::value)
+			{
+				return (long long)r.size();
+			}
+			else
+			{
+				return (long long)std::distance(std::begin(r), std::end(r));
+			}
+		}
+
+	public:
+		struct sentinel
+		{
+			BaseSentinel end;
+		};
+
+		class iterator
+		{
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef typename std::iterator_traits<BaseIterator>::value_type value_type;
+			typedef typename std::iterator_traits<BaseIterator>::difference_type difference_type;
+			typedef typename std::iterator_traits<BaseIterator>::pointer pointer;
+			typedef typename std::iterator_traits<BaseIterator>::reference reference;
+
+			iterator(BaseIterator it, ProgressRange* owner) : it(it), owner(owner), nextCheck(owner->bar.update(0))
+			{
+			}
+			//the loop may end on a break, a return or an exception, the final count is published on every path
+			~iterator()
+			{
+				owner->last = count > owner->last ? count : owner->last;
+			}
+
+			decltype(auto) operator*() const { return *it; }
+
+			//the loop body only pays for the increment and the compare against nextCheck
+			iterator& operator++()
+			{
+				++it;
+				if(++count >= nextCheck)
+				{
+					nextCheck = owner->bar.update(count);
+				}
+				return *this;
+			}
+
+			friend bool operator!=(const iterator& lhs, const sentinel& rhs) { return lhs.it != rhs.end; }
+			friend bool operator==(const iterator& lhs, const sentinel& rhs) { return lhs.it == rhs.end; }
+
+		private:
+			BaseIterator it;
+			ProgressRange* owner;
+			long long count = 0;
+			long long nextCheck;
+		};
+
+		template <typename R>
+		ProgressRange(R&& r, int barSize) : range(std::forward<R>(r)), bar(length(range), barSize)
+		{
+		}
+		~ProgressRange()
+		{
+			bar.finish(last);
+		}
 
+		ProgressBar& progressBar()
+		{
+			return bar;
+		}
+
+		iterator begin() { return iterator(std::begin(range), this); }
+		sentinel end() { return sentinel{std::end(range)}; }
+	};
+
+	template <typename Range, typename std::enable_if<!std::is_integral<typename std::remove_reference<Range>::type>::value, int>::type = 0>
+	ProgressRange<Range> progress(Range&& range, int barSize = 20)
+	{
+		return ProgressRange<Range>(std::forward<Range>(range), barSize);
+	}
+
+	template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+	ProgressRange<CountingRange<T>> progress(T n, int barSize = 20)
+	{
+		return ProgressRange<CountingRange<T>>(CountingRange<T>(n), barSize);
+	}
+
+	class ConcurrentLoadingBar
+	{
+	public:
+		ConcurrentLoadingBar() = delete;
+		ConcurrentLoadingBar(const ConcurrentLoadingBar& oth) = delete;
+
+		ConcurrentLoadingBar(long long total, int barSize = 20, std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+			: total(total), barSize(barSize), interval(interval)
+		{
+			renderer = std::thread(&ConcurrentLoadingBar::render, this);
+		}
+		~ConcurrentLoadingBar()
+		{
+			finish();
+		}
+
+		void tick(long long n = 1, long long bytes = 0)
+		{
+			done.add(n);
+			if(bytes)
+			{
+				processed.add(bytes);
+			}
+		}
+
+		long long count() const
+		{
+			return done.sum();
+		}
+
+		void finish()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if(stopping)
+					return;
+				stopping = true;
+			}
+			m_Condition.notify_one();
+			renderer.join();
+			print();
+			std::cout << std::endl;
+		}
+
+	private:
+		detail::ShardedCounter done;
+		detail::ShardedCounter processed;
+		detail::RateEstimator rate;
+
+		long long total;
+		int barSize;
+		std::chrono::milliseconds interval;
+
+		std::thread renderer;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool stopping = false;
+
+		void render()
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			while(!m_Condition.wait_for(lock, interval, [this] { return stopping; }))
+			{
+				print();
+			}
 		}
 
 		void print()
 		{
-			float percentage = iter / limit;
-			int completed = (int)(barSize * percentage);
-			
-			std::cout << "\r";
-			std::cout << '|';
-			for(int i = 0; i < completed; i++)
+			const long long items = done.sum();
+			const long long bytes = processed.sum();
+			rate.sample(items, bytes, detail::RateEstimator::Clock::now());
+
+			std::string line = "\r";
+			detail::formatBar(line, items, total, barSize, &rate, bytes != 0);
+			line += "    ";
+			std::cout.write(line.data(), line.size());
+			std::cout.flush();
+		}
+	};
+
+	class MultiLoadingBar
+	{
+	public:
+		enum class Mode
+		{
+			AUTO, TTY, LOG
+		};
+
+		class Task
+		{
+		public:
+			Task(const std::string& label, long long total) : label(label), total(total)
+			{
+			}
+
+			void tick(long long n = 1, long long bytes = 0)
+			{
+				done.add(n);
+				if(bytes)
+				{
+					processed.add(bytes);
+				}
+			}
+
+			//restarts the bar, eg. for every iteration of an outer loop. Ticks running concurrently with reset
+			//may be counted before or after it, the renderer never shows a half reset bar
+			void reset(long long newTotal)
 			{
-				std::cout << '#';
+				//odd while the counters are being cleared, a concurrent reset waits until the sequence is even again
+				unsigned seq = resetSeq.load(std::memory_order_relaxed);
+				for(;;)
+				{
+					if(seq & 1)
+					{
+						std::this_thread::yield();
+						seq = resetSeq.load(std::memory_order_relaxed);
+					}
+					else if(resetSeq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				std::atomic_thread_fence(std::memory_order_release);
+				done.reset();
+				processed.reset();
+				total.store(newTotal, std::memory_order_relaxed);
+				resetRequested.store(true, std::memory_order_relaxed);
+				finished.store(false, std::memory_order_relaxed);
+				resetSeq.store(seq + 2, std::memory_order_release);
 			}
-			for(int i = 0; i < barSize - completed; i++)
+
+			void finish()
 			{
-				std::cout << '-';
+				finished.store(true, std::memory_order_release);
 			}
-			std::cout << "| " << iter << "/" << limit << " " << std::setprecision(3) << (percentage * 100) << "%    " << std::flush;
+
+			long long count() const
+			{
+				return done.sum();
+			}
+
+		private:
+			friend class MultiLoadingBar;
+
+			std::string label;
+			std::atomic<long long> total;
+			detail::ShardedCounter done;
+			detail::ShardedCounter processed;
+			std::atomic<bool> finished{false};
+			std::atomic<bool> resetRequested{false};
+			std::atomic<unsigned> resetSeq{0};
+
+			//only touched by the renderer
+			detail::RateEstimator rate;
+			bool reported = false;
+		};
+
+		MultiLoadingBar(const MultiLoadingBar& oth) = delete;
+
+		MultiLoadingBar(Mode mode = Mode::AUTO, int barSize = 20, std::chrono::milliseconds interval = std::chrono::milliseconds(100), std::chrono::seconds logInterval = std::chrono::seconds(10))
+			: barSize(barSize), interval(interval), logInterval(logInterval)
+		{
+			tty = mode == Mode::AUTO ? detail::isTerminal(stdout) : mode == Mode::TTY;
+			renderer = std::thread(&MultiLoadingBar::render, this);
 		}
+		~MultiLoadingBar()
+		{
+			finish();
+		}
+
+		Task& add(const std::string& label, long long total)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			tasks.emplace_back(label, total);
+			return tasks.back();
+		}
+
+		void finish()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if(stopping)
+					return;
+				stopping = true;
+			}
+			m_Condition.notify_one();
+			renderer.join();
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for(Task& t : tasks)
+			{
+				t.finished.store(true, std::memory_order_relaxed);
+			}
+			print(true);
+		}
+
+	private:
+		typedef detail::RateEstimator::Clock Clock;
+
+		std::deque<Task> tasks;
+		int barSize;
+		std::chrono::milliseconds interval;
+		std::chrono::seconds logInterval;
+		bool tty;
+		int drawnLines = 0;
+
+		std::thread renderer;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool stopping = false;
+
+		void render()
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			Clock::time_point lastLog = Clock::now();
+			while(!m_Condition.wait_for(lock, interval, [this] { return stopping; }))
+			{
+				//rates are sampled every interval in both modes, the log only prints every logInterval
+				const Clock::time_point now = Clock::now();
+				const bool logDue = now - lastLog >= logInterval;
+				if(logDue)
+				{
+					lastLog = now;
+				}
+				print(tty || logDue);
+			}
+		}
+
+		//called with m_Mutex held
+		void print(bool periodic)
+		{
+			const Clock::time_point now = Clock::now();
+			size_t labelWidth = 0;
+			for(const Task& t : tasks)
+			{
+				labelWidth = t.label.size() > labelWidth ? t.label.size() : labelWidth;
+			}
 
+			std::string out;
+			if(tty && drawnLines)
+			{
+				//back to the first line of the previous frame
+				out += "\x1b[" + std::to_string(drawnLines) + "A";
+			}
+
+			for(Task& t : tasks)
+			{
+				//consistent snapshot, retried while a reset is in progress
+				bool restarted = false, finished;
+				long long items, bytes, total;
+				for(;;)
+				{
+					const unsigned seq = t.resetSeq.load(std::memory_order_acquire);
+					if(seq & 1)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					restarted |= t.resetRequested.exchange(false, std::memory_order_relaxed);
+					items = t.done.sum();
+					bytes = t.processed.sum();
+					total = t.total.load(std::memory_order_relaxed);
+					finished = t.finished.load(std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if(t.resetSeq.load(std::memory_order_relaxed) == seq)
+					{
+						break;
+					}
+				}
+				if(restarted)
+				{
+					t.rate.reset();
+					t.reported = false;
+				}
+				t.rate.sample(items, bytes, now);
+
+				if(!tty && (t.reported || (!periodic && !finished)))
+				{
+					continue;
+				}
+
+				if(tty)
+				{
+					out += "\r\x1b[2K";
+				}
+				out += t.label;
+				out.append(labelWidth - t.label.size() + 1, ' ');
+				detail::formatBar(out, items, total, barSize, &t.rate, bytes != 0);
+				if(!tty && finished)
+				{
+					out += " done";
+					t.reported = true;
+				}
+				out += '\n';
+			}
+
+			if(tty)
+			{
+				drawnLines = (int)tasks.size();
+			}
+			if(!out.empty())
+			{
+				std::cout.write(out.data(), out.size());
+				std::cout.flush();
+			}
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+#include "threadPool.h"
+
+/*
+Minimal parallel loop helper shared by the library's parallel algorithms.
+
+The range [begin, end> is cut into chunks of grain elements and the chunks are handed out to worker threads.
+Chunk boundaries only depend on begin, end and grain, never on the number of threads, so algorithms which
+keep one partial result per chunk are reproducible on any machine. The chunks run on ThreadPool::shared(threads)
+(threadPool.h), ThreadPool::global() with the default thread count, so no threads are started per call and nested
+loops share the workers.
+
+
+unsigned hardwareThreads()
+Number of hardware threads (at least 1), defined in threadPool.h.
+
+void parallelFor(size_t begin, size_t end, size_t grain, F func, unsigned threads = hardwareThreads())
+Calls func(chunkBegin, chunkEnd) for every chunk. The calling thread takes part in the work. Fewer threads than
+hardwareThreads() (eg. for comparing thread counts) use a pool of that size, which is kept for later calls.
+An exception thrown by func is rethrown after the running chunks have finished.
+
+size_t chunkCount(size_t begin, size_t end, size_t grain)
+Number of chunks parallelFor will create, eg. for sizing a vector of partial results.
+
+
+Example:
+
+std::vector<double> partial(lameutil::chunkCount(0, n, 4096));
+lameutil::parallelFor(0, n, 4096, [&](size_t lo, size_t hi)
+{
+	double sum = 0;
+	for(size_t i = lo; i < hi; i++)
+		sum += data[i];
+	partial[lo / 4096] = sum;
+});
+
+*/
+
+namespace lameutil
+{
+	inline size_t chunkCount(size_t begin, size_t end, size_t grain)
+	{
+		return end > begin ? (end - begin + grain - 1) / grain : 0;
+	}
+
+	template <typename F>
+	void parallelFor(size_t begin, size_t end, size_t grain, F func, unsigned threads = hardwareThreads())
+	{
+		if(grain == 0)
+		{
+			grain = 1;
+		}
+		const size_t chunks = chunkCount(begin, end, grain);
+		const size_t workers = std::min<size_t>(threads, chunks);
+		if(workers <= 1)
+		{
+			for(size_t lo = begin; lo < end; lo += grain)
+			{
+				func(lo, std::min(end, lo + grain));
+			}
+			return;
+		}
+		ThreadPool::shared(threads).parallelFor(begin, end, grain, func);
+	}
+}
@@ -7,6 +7,7 @@
 #include <cassert>
 #include <thread>
 #include <mutex>
+#include <vector>
 /*
 Basic instrumentation profiler by Cherno
 Forked by Lame
@@ -17,6 +18,7 @@ Usage:
         PROFILE_END_SESSION()
         PROFILE_SCOPE(std::string scopeName)
         PROFILE_FUNCTION()
+        PROFILE_THREAD_NAME(std::string threadName, int sortIndex)
     macros while defining
         #define PROFILING 1
     before the header.
@@ -44,6 +46,9 @@ Example:
 
 For multithreading purposes, define
     #define PROFILING_MULTITHREAD 1
+
+PROFILE_THREAD_NAME names the calling thread in the trace (shown instead of its id, tracks ordered by sortIndex).
+Names are kept across sessions, so threads can be named once when they start, eg. the workers of ThreadPool.
 */
 
 #if PROFILING
@@ -51,11 +56,13 @@ For multithreading purposes, define
 #define PROFILE_END_SESSION() lameutil::Instrumentor::Get().EndSession()
 #define PROFILE_SCOPE(scopeName) lameutil::InstrumentationTimer timer##__LINE__(scopeName)
 #define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCSIG__)
+#define PROFILE_THREAD_NAME(threadName, sortIndex) lameutil::Instrumentor::Get().SetThreadName(threadName, sortIndex)
 #else 
 #define PROFILE_BEGIN_SESSION()
 #define PROFILE_END_SESSION()
 #define PROFILE_SCOPE(scopeName)
 #define PROFILE_FUNCTION()
+#define PROFILE_THREAD_NAME(threadName, sortIndex)
 #endif
 
 namespace lameutil
@@ -68,6 +75,13 @@ namespace lameutil
         std::thread::id ThreadID;
     };
 
+    struct ThreadName
+    {
+        std::thread::id ThreadID;
+        std::string Name;
+        int SortIndex;
+    };
+
     class Instrumentor
     {
     private:
@@ -80,6 +94,10 @@ namespace lameutil
         std::string m_Filepath;
         bool m_SessionStarted;
 
+        //guards the names and the session state against threads naming themselves
+        std::mutex m_NamesMutex;
+        std::vector<ThreadName> m_ThreadNames;
+
         Instrumentor()
             : m_ProfileCount{0}, m_Filepath{""}, m_SessionStarted{false}
         {
@@ -103,14 +121,18 @@ namespace lameutil
 
         void BeginSession(const std::string& name = "session")
         {
+            std::lock_guard<std::mutex> lock(m_NamesMutex);
             assert(!m_SessionStarted && "Unable to start multiple sessions in parallel.");
             m_SessionStarted = true;
             m_OutputStream.open(m_Filepath + name + ".session.json");
             WriteHeader();
+            for(const ThreadName& threadName : m_ThreadNames)
+                WriteThreadName(threadName);
         }
 
         void EndSession()
         {
+            std::lock_guard<std::mutex> lock(m_NamesMutex);
             WriteFooter();
             m_OutputStream.close();
             m_ProfileCount = 0;
@@ -141,6 +163,33 @@ namespace lameutil
             //m_OutputStream.flush();
         }
 
+        void SetThreadName(const std::string& name, int sortIndex = 0)
+        {
+            std::lock_guard<std::mutex> lock(m_NamesMutex);
+            m_ThreadNames.push_back({std::this_thread::get_id(), name, sortIndex});
+            if(m_SessionStarted)
+                WriteThreadName(m_ThreadNames.back());
+        }
+
+        //chrome trace metadata events, the name and the position of the track of a thread
+        void WriteThreadName(const ThreadName& threadName)
+        {
+#ifdef PROFILING_MULTITHREAD
+            std::lock_guard<std::mutex> lock(writeMutex);
+#endif
+            std::string name = threadName.Name;
+            std::replace(name.begin(), name.end(), '"', '\'');
+
+            if(m_ProfileCount++ > 0)
+                m_OutputStream << ",";
+            m_OutputStream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,";
+            m_OutputStream << "\"tid\":" << threadName.ThreadID << ",";
+            m_OutputStream << "\"args\":{\"name\":\"" << name << "\"}},";
+            m_OutputStream << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,";
+            m_OutputStream << "\"tid\":" << threadName.ThreadID << ",";
+            m_OutputStream << "\"args\":{\"sort_index\":" << threadName.SortIndex << "}}";
+        }
+
         void WriteHeader()
         {
             m_OutputStream << "{\"otherData\": {},\"traceEvents\":[";
@@ -0,0 +1,257 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+#include "easyRandom.h"
+
+/*
+Reproducible parallel random number streams.
+
+Xoshiro256 is the xoshiro256** engine (Blackman & Vigna). It satisfies the standard UniformRandomBitGenerator
+requirements, so it can be used with BasicEasyRandom and with the standard distributions.
+jump() advances the engine by 2^128 steps and long_jump() by 2^192 steps, which gives non-overlapping subsequences.
+
+RandomStreams hands out generators from a single master seed. Stream i is always the base engine advanced by
+i jumps, so the numbers a task draws depend only on its index and never on which thread runs it or how many
+threads there are.
+
+
+Xoshiro256(uint64_t seed)
+Constructor which expands the seed into the full 256 bit state with splitmix64.
+
+void jump() / void long_jump()
+Advance the engine by 2^128 / 2^192 steps.
+
+RandomStreams(uint64_t masterSeed)
+Constructor which seeds the base engine of the factory.
+
+Xoshiro256 engine(size_t index)
+Returns the engine of stream index. Costs index jumps, use streams() when many consecutive streams are needed.
+
+BasicEasyRandom<Xoshiro256> stream(size_t index)
+Same as engine(index), wrapped in the EasyRandom interface.
+
+std::vector<BasicEasyRandom<Xoshiro256>> streams(size_t count)
+Returns streams [0, count> in O(count) jumps.
+
+RandomStreams family(size_t index)
+Returns a factory whose base is advanced by index long jumps. Families never overlap each other,
+which allows a two level split (eg. one family per simulation run, one stream per task).
+
+
+Example:
+
+lameutil::RandomStreams factory(42);
+auto rgs = factory.streams(tasks);
+std::vector<double> out(tasks);
+#pragma omp parallel for
+for(int i = 0; i < tasks; i++)
+{
+	out[i] = rgs[i].getDouble();
+}
+--------------------
+out is identical for any number of threads.
+
+*/
+
+namespace lameutil
+{
+	class SplitMix64
+	{
+	private:
+		uint64_t state;
+
+	public:
+		explicit SplitMix64(uint64_t seed) : state(seed)
+		{
+		}
+
+		uint64_t operator()()
+		{
+			uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+	};
+
+	class Xoshiro256
+	{
+	private:
+		uint64_t s[4];
+
+		static inline uint64_t rotl(const uint64_t x, int k)
+		{
+			return (x << k) | (x >> (64 - k));
+		}
+
+		void advance(const uint64_t (&table)[4])
+		{
+			uint64_t t[4] = {0, 0, 0, 0};
+			for(int i = 0; i < 4; i++)
+			{
+				for(int b = 0; b < 64; b++)
+				{
+					if(table[i] & (uint64_t(1) << b))
+					{
+						t[0] ^= s[0];
+						t[1] ^= s[1];
+						t[2] ^= s[2];
+						t[3] ^= s[3];
+					}
+					(*this)();
+				}
+			}
+			s[0] = t[0];
+			s[1] = t[1];
+			s[2] = t[2];
+			s[3] = t[3];
+		}
+
+	public:
+		typedef uint64_t result_type;
+
+		static constexpr uint64_t default_seed = 0x853c49e6748fea9bULL;
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		Xoshiro256()
+		{
+			seed(default_seed);
+		}
+		explicit Xoshiro256(uint64_t value)
+		{
+			seed(value);
+		}
+		explicit Xoshiro256(std::seed_seq& seq)
+		{
+			seed(seq);
+		}
+
+		void seed(uint64_t value)
+		{
+			SplitMix64 sm(value);
+			for(int i = 0; i < 4; i++)
+			{
+				s[i] = sm();
+			}
+		}
+		void seed(std::seed_seq& seq)
+		{
+			uint32_t words[8];
+			seq.generate(words, words + 8);
+			for(int i = 0; i < 4; i++)
+			{
+				s[i] = (uint64_t(words[2 * i + 1]) << 32) | words[2 * i];
+			}
+			//the all zero state is the only invalid one
+			if((s[0] | s[1] | s[2] | s[3]) == 0)
+			{
+				seed(default_seed);
+			}
+		}
+
+		result_type operator()()
+		{
+			const uint64_t result = rotl(s[1] * 5, 7) * 9;
+			const uint64_t t = s[1] << 17;
+
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+
+			s[2] ^= t;
+			s[3] = rotl(s[3], 45);
+
+			return result;
+		}
+
+		void discard(unsigned long long n)
+		{
+			for(; n; n--)
+			{
+				(*this)();
+			}
+		}
+
+		void jump()
+		{
+			static const uint64_t JUMP[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+			advance(JUMP);
+		}
+
+		void long_jump()
+		{
+			static const uint64_t LONG_JUMP[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+			advance(LONG_JUMP);
+		}
+
+		friend bool operator==(const Xoshiro256& lhs, const Xoshiro256& rhs)
+		{
+			return lhs.s[0] == rhs.s[0] && lhs.s[1] == rhs.s[1] && lhs.s[2] == rhs.s[2] && lhs.s[3] == rhs.s[3];
+		}
+		friend bool operator!=(const Xoshiro256& lhs, const Xoshiro256& rhs)
+		{
+			return !(lhs == rhs);
+		}
+	};
+
+	class RandomStreams
+	{
+	private:
+		Xoshiro256 base;
+
+		explicit RandomStreams(const Xoshiro256& engine) : base(engine)
+		{
+		}
+
+	public:
+		typedef BasicEasyRandom<Xoshiro256> stream_type;
+
+		explicit RandomStreams(uint64_t masterSeed) : base(masterSeed)
+		{
+		}
+
+		Xoshiro256 engine(size_t index) const
+		{
+			Xoshiro256 ret = base;
+			for(; index; index--)
+			{
+				ret.jump();
+			}
+			return ret;
+		}
+
+		stream_type stream(size_t index) const
+		{
+			return stream_type(engine(index));
+		}
+
+		std::vector<stream_type> streams(size_t count) const
+		{
+			std::vector<stream_type> ret;
+			ret.reserve(count);
+			Xoshiro256 current = base;
+			for(size_t i = 0; i < count; i++)
+			{
+				ret.emplace_back(current);
+				current.jump();
+			}
+			return ret;
+		}
+
+		RandomStreams family(size_t index) const
+		{
+			Xoshiro256 ret = base;
+			for(; index; index--)
+			{
+				ret.long_jump();
+			}
+			return RandomStreams(ret);
+		}
+	};
+}
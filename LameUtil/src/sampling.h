@@ -0,0 +1,367 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <initializer_list>
+#include "easyRandom.h"
+#include "randomStreams.h"
+#include "distributions.h"
+
+/*
+Weighted discrete sampling and streaming sampling.
+
+AliasTable samples an index i with probability weight[i] / sum(weights) in O(1), using one 64 bit draw
+(32 bits select the column, 32 bits decide between the column and its alias). The table is built with
+Vose's method in O(n). Weights can be changed in place, the table has to be rebuilt afterwards.
+
+ReservoirSampler keeps a uniform sample of k items from a stream of unknown length using Li's algorithm L.
+The number of random draws is O(k * (1 + log(N / k))) and the items between two replacements are skipped
+without touching the generator.
+
+
+AliasTable(const std::vector<double>& weights) / AliasTable(It first, It last)
+Builds the table from non-negative weights (at least one must be positive, at most 2^32 - 1 entries).
+
+size_t operator()(Engine& g) / size_t sample(BasicEasyRandom<Engine>& rg)
+Returns a random index.
+
+void setWeight(size_t i, double w)
+Changes one weight in place. rebuild() must be called before sampling again.
+
+void rebuild()
+Rebuilds the table from the current weights in O(n).
+
+ReservoirSampler<T, Engine = Xoshiro256>(size_t k, uint64_t seed) / ReservoirSampler(size_t k, const Engine& engine)
+Constructs an empty reservoir of capacity k.
+
+void add(T item)
+Offers the next item of the stream. Costs one compare unless the item is selected.
+
+void add(It first, It last)
+Offers a whole range, random access ranges jump over the skipped items without reading them.
+
+const std::vector<T>& sample()
+The current reservoir, min(k, seen()) items in no particular order.
+
+
+Example:
+
+lameutil::EasyRandom rg;
+lameutil::AliasTable table({1.0, 2.0, 7.0});
+size_t i = table.sample(rg); //2 with probability 0.7
+
+lameutil::ReservoirSampler<std::string> reservoir(10, 42);
+std::string line;
+while(std::getline(file, line))
+	reservoir.add(line);
+for(const std::string& s : reservoir.sample())
+	std::cout << s << std::endl;
+
+*/
+
+namespace lameutil
+{
+	class AliasTable
+	{
+	private:
+		struct Entry
+		{
+			uint32_t threshold;
+			uint32_t alias;
+		};
+
+		std::vector<double> weights;
+		std::vector<Entry> table;
+		double total = 0;
+		bool dirty = false;
+
+	public:
+		AliasTable() = default;
+
+		AliasTable(const std::vector<double>& w) : weights(w)
+		{
+			rebuild();
+		}
+		AliasTable(std::initializer_list<double> w) : weights(w)
+		{
+			rebuild();
+		}
+		template <typename It>
+		AliasTable(It first, It last) : weights(first, last)
+		{
+			rebuild();
+		}
+
+		size_t size() const
+		{
+			return weights.size();
+		}
+
+		double weight(size_t i) const
+		{
+			assert(i < weights.size());
+			return weights[i];
+		}
+
+		double probability(size_t i) const
+		{
+			assert(i < weights.size());
+			return weights[i] / total;
+		}
+
+		void setWeight(size_t i, double w)
+		{
+			assert(i < weights.size() && w >= 0);
+			total += w - weights[i];
+			weights[i] = w;
+			dirty = true;
+		}
+
+		void assign(const std::vector<double>& w)
+		{
+			weights = w;
+			rebuild();
+		}
+
+		void rebuild()
+		{
+			const size_t n = weights.size();
+			assert(n > 0 && n < 0xffffffffULL);
+
+			total = 0;
+			for(double w : weights)
+			{
+				assert(w >= 0);
+				total += w;
+			}
+			assert(total > 0);
+
+			table.resize(n);
+			std::vector<double> scaled(n);
+			std::vector<uint32_t> under, over;
+			under.reserve(n);
+			over.reserve(n);
+
+			const double scale = n / total;
+			for(size_t i = 0; i < n; i++)
+			{
+				scaled[i] = weights[i] * scale;
+				(scaled[i] < 1.0 ? under : over).push_back((uint32_t)i);
+			}
+
+			while(!under.empty() && !over.empty())
+			{
+				const uint32_t s = under.back();
+				const uint32_t l = over.back();
+				under.pop_back();
+
+				table[s].threshold = toThreshold(scaled[s]);
+				table[s].alias = l;
+
+				scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+				if(scaled[l] < 1.0)
+				{
+					over.pop_back();
+					under.push_back(l);
+				}
+			}
+			//what is left is 1 up to rounding errors
+			for(uint32_t i : over)
+			{
+				table[i] = Entry{0xffffffffu, i};
+			}
+			for(uint32_t i : under)
+			{
+				table[i] = Entry{0xffffffffu, i};
+			}
+			dirty = false;
+		}
+
+		template <typename Engine>
+		size_t operator()(Engine& g) const
+		{
+			assert(!dirty && "AliasTable::rebuild() must be called after setWeight().");
+			const uint64_t bits = detail::randomBits64(g);
+			const size_t column = (size_t)(((bits >> 32) * table.size()) >> 32);
+			const Entry& e = table[column];
+			return (uint32_t)bits < e.threshold ? column : e.alias;
+		}
+
+		template <typename Engine>
+		size_t sample(BasicEasyRandom<Engine>& rg) const
+		{
+			return (*this)(rg.engine());
+		}
+
+	private:
+		static uint32_t toThreshold(double p)
+		{
+			const double t = p * 4294967296.0;
+			return t >= 4294967295.0 ? 0xffffffffu : (uint32_t)t;
+		}
+	};
+
+	template <typename T, typename Engine = Xoshiro256>
+	class ReservoirSampler
+	{
+	private:
+		std::vector<T> reservoir;
+		size_t k;
+		uint64_t count = 0;
+		uint64_t next = 0;
+		double w = 0;
+		Engine generator;
+
+	public:
+		ReservoirSampler(size_t k, uint64_t seed) : k(k), generator(seed)
+		{
+			assert(k > 0);
+			reservoir.reserve(k);
+		}
+		ReservoirSampler(size_t k, const Engine& engine) : k(k), generator(engine)
+		{
+			assert(k > 0);
+			reservoir.reserve(k);
+		}
+
+		void add(const T& item)
+		{
+			if(count < k)
+			{
+				reservoir.push_back(item);
+				fillStep();
+			}
+			else if(++count == next)
+			{
+				replace() = item;
+			}
+		}
+		void add(T&& item)
+		{
+			if(count < k)
+			{
+				reservoir.push_back(std::move(item));
+				fillStep();
+			}
+			else if(++count == next)
+			{
+				replace() = std::move(item);
+			}
+		}
+
+		template <typename It>
+		void add(It first, It last)
+		{
+			for(; first != last && count < k; ++first)
+			{
+				add(*first);
+			}
+			while(first != last)
+			{
+				uint64_t gap = skip();
+				if constexpr(std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category>::value)
+				{
+					const uint64_t left = (uint64_t)(last - first);
+					if(gap >= left)
+					{
+						count += left;
+						return;
+					}
+					first += (typename std::iterator_traits<It>::difference_type)gap;
+					count += gap;
+				}
+				else
+				{
+					for(; gap && first != last; gap--, ++first)
+					{
+						count++;
+					}
+					if(first == last)
+					{
+						return;
+					}
+				}
+				add(*first);
+				++first;
+			}
+		}
+
+		//number of upcoming items that will not be selected, a source can drop them without reading
+		uint64_t skip() const
+		{
+			return count < k ? 0 : next - count - 1;
+		}
+
+		//tells the sampler that n items were dropped, n must not exceed skip()
+		void skipped(uint64_t n)
+		{
+			assert(n <= skip());
+			count += n;
+		}
+
+		const std::vector<T>& sample() const
+		{
+			return reservoir;
+		}
+
+		uint64_t seen() const
+		{
+			return count;
+		}
+
+		size_t capacity() const
+		{
+			return k;
+		}
+
+	private:
+		double uniform()
+		{
+			return detail::toOpenUnitDouble(detail::randomBits64(generator));
+		}
+
+		void fillStep()
+		{
+			if(++count == k)
+			{
+				w = std::exp(std::log(uniform()) / k);
+				scheduleNext();
+			}
+		}
+
+		void scheduleNext()
+		{
+			next = count + (uint64_t)std::floor(std::log(uniform()) / std::log1p(-w)) + 1;
+		}
+
+		//uniform index into the reservoir, 32 bit multiply-shift while k <= 2^32 and a 64 bit modulo with rejection beyond
+		size_t randomSlot()
+		{
+			const uint64_t range = (uint64_t)k;
+			uint64_t bits = detail::randomBits64(generator);
+			if(range <= (uint64_t(1) << 32))
+			{
+				return (size_t)(((bits >> 32) * range) >> 32);
+			}
+			const uint64_t threshold = (0 - range) % range;
+			while(bits < threshold)
+			{
+				bits = detail::randomBits64(generator);
+			}
+			return (size_t)(bits % range);
+		}
+
+		T& replace()
+		{
+			T& slot = reservoir[randomSlot()];
+			w *= std::exp(std::log(uniform()) / k);
+			scheduleNext();
+			return slot;
+		}
+	};
+}
@@ -0,0 +1,122 @@
+/*
+Exception and thread count tests of threadPool.h and parallel.h.
+
+g++ -std=c++17 -O2 -g -fsanitize=address -I../src threadPoolTest.cpp -pthread && ./a.out
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include "threadPool.h"
+#include "parallel.h"
+
+#define CHECK(x) do { if(!(x)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); std::exit(1); } } while(0)
+
+using namespace lameutil;
+
+//the message of the exception thrown by f, empty if none
+template <typename F>
+std::string caught(F f)
+{
+	try
+	{
+		f();
+	}
+	catch(const std::runtime_error& e)
+	{
+		return e.what();
+	}
+	return "";
+}
+
+static void throwingLoops()
+{
+	ThreadPool pool(4);
+	for(int run = 0; run < 100; run++)
+	{
+		//the chunks keep running on the workers while the first one throws on the calling thread
+		CHECK(caught([&]()
+		{
+			pool.parallelFor(0, 64, 1, [](size_t lo, size_t)
+			{
+				if(lo == 0)
+					throw std::runtime_error("chunk 0");
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			});
+		}) == "chunk 0");
+
+		CHECK(caught([&]()
+		{
+			pool.parallelReduce(0, 1000, 10, 0, [](size_t lo, size_t hi)
+			{
+				if(lo == 990)
+					throw std::runtime_error("last chunk");
+				return (int)(hi - lo);
+			}, [](int a, int b) { return a + b; });
+		}) == "last chunk");
+
+		//a nested loop throwing on a worker reaches the outer caller
+		CHECK(caught([&]()
+		{
+			pool.parallelFor(0, 8, 1, [&](size_t lo, size_t)
+			{
+				pool.parallelFor(0, 8, 1, [&](size_t inner, size_t)
+				{
+					if(lo == 5 && inner == 3)
+						throw std::runtime_error("nested");
+				});
+			});
+		}) == "nested");
+
+		//the pool and the context of this thread are intact afterwards
+		std::vector<int> out(1000);
+		pool.parallelFor(0, out.size(), 7, [&](size_t lo, size_t hi)
+		{
+			for(size_t i = lo; i < hi; i++)
+				out[i] = (int)i;
+		});
+		for(size_t i = 0; i < out.size(); i++)
+			CHECK(out[i] == (int)i);
+		const int sum = pool.parallelReduce(0, 1000, 10, 0, [](size_t lo, size_t hi) { return (int)(hi - lo); },
+			[](int a, int b) { return a + b; });
+		CHECK(sum == 1000);
+	}
+}
+
+static void limitedThreads()
+{
+	//fewer threads than the hardware has run on a kept pool of that size, which is reused
+	CHECK(&ThreadPool::shared(2) == &ThreadPool::shared(2));
+	CHECK(ThreadPool::shared(2).size() == 2 || hardwareThreads() <= 2);
+	CHECK(&ThreadPool::shared(hardwareThreads()) == &ThreadPool::global());
+
+	for(unsigned threads = 1; threads <= 4; threads++)
+	{
+		std::vector<int> out(10000);
+		parallelFor(0, out.size(), 100, [&](size_t lo, size_t hi)
+		{
+			for(size_t i = lo; i < hi; i++)
+				out[i] = (int)(2 * i);
+		}, threads);
+		for(size_t i = 0; i < out.size(); i++)
+			CHECK(out[i] == (int)(2 * i));
+
+		CHECK(caught([&]()
+		{
+			parallelFor(0, 100, 1, [](size_t lo, size_t)
+			{
+				if(lo == 50)
+					throw std::runtime_error("limited");
+			}, threads);
+		}) == "limited");
+	}
+}
+
+int main()
+{
+	throwingLoops();
+	limitedThreads();
+	std::printf("threadPoolTest passed\n");
+	return 0;
+}